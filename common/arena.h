@@ -0,0 +1,125 @@
+#ifndef COMMON_ARENA_H
+#define COMMON_ARENA_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * Bump allocator over one anonymous mapping for the matrix and vector buffers of a
+ * benchmark: every block is aligned (64 bytes at least), the mapping can be backed by
+ * transparent or explicit (hugetlbfs) huge pages, and it is kept across trials and reused
+ * with arena_reset instead of being unmapped and faulted in again.
+ * Pages are never touched here: each lands on the NUMA node of the thread that writes it
+ * first, so buffers should be initialized by the threads that later compute on them.
+ */
+#define ARENA_HUGE_PAGE_SIZE (2u << 20)
+
+typedef enum {
+    ARENA_PAGES_DEFAULT = 0,     /* base pages (THP as the system default says) */
+    ARENA_PAGES_TRANSPARENT = 1, /* madvise(MADV_HUGEPAGE) on a 2 MiB aligned range */
+    ARENA_PAGES_EXPLICIT = 2     /* MAP_HUGETLB, from the pages reserved in vm.nr_hugepages */
+} ArenaPages;
+
+typedef struct {
+    void *map;        /* whole mapping */
+    size_t map_bytes;
+    char *base;       /* first usable byte */
+    size_t capacity;
+    size_t used;
+    ArenaPages pages; /* pages actually obtained */
+} Arena;
+
+static inline const char *arena_pages_name(ArenaPages pages) {
+    switch (pages) {
+        case ARENA_PAGES_TRANSPARENT: return "transparent huge";
+        case ARENA_PAGES_EXPLICIT: return "explicit huge";
+        default: return "default";
+    }
+}
+
+/**
+ * @brief Parses "default", "thp" or "hugetlb".
+ * @return 0 on success, -1 for an unknown name.
+ */
+static inline int arena_pages_from_name(const char *name, ArenaPages *pages) {
+    if (strcmp(name, "default") == 0) *pages = ARENA_PAGES_DEFAULT;
+    else if (strcmp(name, "thp") == 0) *pages = ARENA_PAGES_TRANSPARENT;
+    else if (strcmp(name, "hugetlb") == 0) *pages = ARENA_PAGES_EXPLICIT;
+    else return -1;
+    return 0;
+}
+
+static inline size_t arena_round_up(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+/**
+ * @brief Reserves capacity bytes with the requested pages. If explicit huge pages are not
+ *        available (none reserved), falls back to transparent ones; arena->pages tells which.
+ * @return 0 on success, -1 on error (the message is printed to stderr).
+ */
+static inline int arena_init(Arena *arena, size_t capacity, ArenaPages pages) {
+    memset(arena, 0, sizeof(*arena));
+    capacity = arena_round_up(capacity ? capacity : 1, ARENA_HUGE_PAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+    if (pages == ARENA_PAGES_EXPLICIT) {
+        void *map = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (map != MAP_FAILED) {
+            arena->map = map;
+            arena->map_bytes = capacity;
+            arena->base = (char *)map;
+            arena->capacity = capacity;
+            arena->pages = ARENA_PAGES_EXPLICIT;
+            return 0;
+        }
+    }
+#endif
+    if (pages == ARENA_PAGES_EXPLICIT) pages = ARENA_PAGES_TRANSPARENT;
+
+    /* One huge page more than needed, so the usable range can start on a huge page boundary. */
+    const size_t map_bytes = capacity + ARENA_HUGE_PAGE_SIZE;
+    void *map = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error reserving %zu bytes\n", map_bytes);
+        return -1;
+    }
+    arena->map = map;
+    arena->map_bytes = map_bytes;
+    arena->base = (char *)arena_round_up((uintptr_t)map, ARENA_HUGE_PAGE_SIZE);
+    arena->capacity = capacity;
+    arena->pages = pages;
+#ifdef MADV_HUGEPAGE
+    if (pages == ARENA_PAGES_TRANSPARENT) madvise(arena->base, capacity, MADV_HUGEPAGE);
+#else
+    arena->pages = ARENA_PAGES_DEFAULT;
+#endif
+    return 0;
+}
+
+/**
+ * @brief Next bytes of the arena, aligned to align (a power of two; 64 at least).
+ * @return The block, or NULL if the arena is full.
+ */
+static inline void *arena_alloc(Arena *arena, size_t bytes, size_t align) {
+    if (align < 64) align = 64;
+    size_t offset = arena_round_up(arena->used, align);
+    if (offset > arena->capacity || bytes > arena->capacity - offset) return NULL;
+    arena->used = offset + bytes;
+    return arena->base + offset;
+}
+
+/**
+ * @brief Frees all blocks at once; the pages stay mapped and are reused by the next allocations.
+ */
+static inline void arena_reset(Arena *arena) { arena->used = 0; }
+
+static inline void arena_release(Arena *arena) {
+    if (arena->map) munmap(arena->map, arena->map_bytes);
+    memset(arena, 0, sizeof(*arena));
+}
+
+#endif /* COMMON_ARENA_H */
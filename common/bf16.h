@@ -0,0 +1,35 @@
+#ifndef COMMON_BF16_H
+#define COMMON_BF16_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief bfloat16: the upper 16 bits of an IEEE float (8-bit exponent, 7-bit mantissa).
+ *        Same range as float, about 3 significant decimal digits; widening to float
+ *        is a 16-bit shift, so SIMD kernels can convert it without F16C.
+ */
+typedef uint16_t bf16_t;
+
+/**
+ * @brief Rounds a float to the nearest bf16 (ties to even); NaN stays NaN.
+ */
+static inline bf16_t bf16_from_float(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) return (bf16_t)((bits >> 16) | 0x0040u);
+    bits += 0x7fffu + ((bits >> 16) & 1u);
+    return (bf16_t)(bits >> 16);
+}
+
+/**
+ * @brief Exact conversion of a bf16 to float.
+ */
+static inline float bf16_to_float(bf16_t value) {
+    uint32_t bits = (uint32_t)value << 16;
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+#endif /* COMMON_BF16_H */
@@ -0,0 +1,148 @@
+#ifndef COMMON_MATRIX_FILE_H
+#define COMMON_MATRIX_FILE_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Row-major matrix stored in a binary file and memory-mapped read-only.
+ * Layout: a MatrixFileHeader padded to MATRIX_FILE_DATA_OFFSET bytes (one page,
+ * so the data is page-aligned), then rows * cols elements. The header is
+ * written last, so a file whose creation was interrupted is not reused.
+ */
+#define MATRIX_FILE_MAGIC "MATFILE1"
+#define MATRIX_FILE_DATA_OFFSET 4096
+
+/* Bytes generated and written per pwrite while creating a file. */
+#define MATRIX_FILE_WRITE_CHUNK (64u << 20)
+
+typedef struct {
+    char magic[8];
+    uint64_t rows;
+    uint64_t cols;
+    uint32_t elem_size;
+    char type_name[20];
+} MatrixFileHeader;
+
+typedef struct {
+    void *map;        /* whole mapping, header included */
+    size_t map_bytes;
+    void *data;       /* first element */
+    size_t row_bytes;
+    int created;      /* 1 if the file was (re)written by matrix_file_open */
+} MatrixFile;
+
+/**
+ * @brief Fills rows [r0, r1) of a cols-wide matrix; rows points to the element (r0, 0).
+ */
+typedef void (*MatrixFillFn)(void *rows, size_t r0, size_t r1, size_t cols);
+
+/**
+ * @brief Opens the matrix file at path, or (re)creates it with fill if it is missing or was
+ *        written for another size or element type, and maps it read-only.
+ *        Creation writes the file in chunks, so the matrix never has to fit in memory.
+ * @return 0 on success, -1 on error (the message is printed to stderr).
+ */
+static inline int matrix_file_open(MatrixFile *mf, const char *path, uint64_t rows, uint64_t cols,
+                                   uint32_t elem_size, const char *type_name, MatrixFillFn fill) {
+    MatrixFileHeader expected;
+    memset(&expected, 0, sizeof(expected));
+    memcpy(expected.magic, MATRIX_FILE_MAGIC, sizeof(expected.magic));
+    expected.rows = rows;
+    expected.cols = cols;
+    expected.elem_size = elem_size;
+    strncpy(expected.type_name, type_name, sizeof(expected.type_name) - 1);
+
+    const size_t row_bytes = (size_t)cols * elem_size;
+    const size_t map_bytes = MATRIX_FILE_DATA_OFFSET + (size_t)rows * row_bytes;
+
+    memset(mf, 0, sizeof(*mf));
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        MatrixFileHeader found;
+        struct stat st;
+        int valid = pread(fd, &found, sizeof(found), 0) == (ssize_t)sizeof(found) &&
+                    memcmp(&found, &expected, sizeof(found)) == 0 && fstat(fd, &st) == 0 &&
+                    (size_t)st.st_size == map_bytes;
+        if (!valid) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd < 0) {
+        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, (off_t)map_bytes) != 0) {
+            fprintf(stderr, "Error creating matrix file %s\n", path);
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+
+        size_t chunk_rows = MATRIX_FILE_WRITE_CHUNK / (row_bytes ? row_bytes : 1);
+        if (chunk_rows == 0) chunk_rows = 1;
+        void *buffer = malloc(chunk_rows * row_bytes);
+        int failed = buffer == NULL;
+        for (size_t r0 = 0; r0 < rows && !failed; r0 += chunk_rows) {
+            size_t r1 = (r0 + chunk_rows < rows) ? r0 + chunk_rows : rows;
+            size_t bytes = (r1 - r0) * row_bytes;
+            fill(buffer, r0, r1, cols);
+            failed = pwrite(fd, buffer, bytes, (off_t)(MATRIX_FILE_DATA_OFFSET + r0 * row_bytes)) != (ssize_t)bytes;
+        }
+        free(buffer);
+        if (failed || pwrite(fd, &expected, sizeof(expected), 0) != (ssize_t)sizeof(expected)) {
+            fprintf(stderr, "Error writing matrix file %s\n", path);
+            close(fd);
+            return -1;
+        }
+        mf->created = 1;
+    }
+
+    void *map = mmap(NULL, map_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error mapping matrix file %s\n", path);
+        return -1;
+    }
+    madvise(map, map_bytes, MADV_SEQUENTIAL);
+
+    mf->map = map;
+    mf->map_bytes = map_bytes;
+    mf->data = (char *)map + MATRIX_FILE_DATA_OFFSET;
+    mf->row_bytes = row_bytes;
+    return 0;
+}
+
+/**
+ * @brief Passes advice (MADV_WILLNEED to start readahead, MADV_DONTNEED to drop the pages
+ *        from the mapping) for rows [r0, r1), widened to whole pages.
+ */
+static inline void matrix_file_advise(const MatrixFile *mf, size_t r0, size_t r1, int advice) {
+    if (r1 <= r0) return;
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)mf->data + r0 * mf->row_bytes;
+    uintptr_t end = (uintptr_t)mf->data + r1 * mf->row_bytes;
+    begin &= ~(page - 1);
+    end = (end + page - 1) & ~(page - 1);
+    madvise((void *)begin, end - begin, advice);
+}
+
+/**
+ * @brief Rows per streamed panel: about panel_bytes of the matrix, a multiple of row_block.
+ */
+static inline size_t matrix_file_panel_rows(const MatrixFile *mf, size_t panel_bytes, size_t row_block) {
+    size_t rows = panel_bytes / (mf->row_bytes ? mf->row_bytes : 1) / row_block * row_block;
+    return rows ? rows : row_block;
+}
+
+static inline void matrix_file_close(MatrixFile *mf) {
+    if (mf->map) munmap(mf->map, mf->map_bytes);
+    memset(mf, 0, sizeof(*mf));
+}
+
+#endif /* COMMON_MATRIX_FILE_H */
@@ -0,0 +1,289 @@
+#ifndef COMMON_SIMD_MATH_H
+#define COMMON_SIMD_MATH_H
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Elementary functions evaluated on several lanes at once, written with GCC vector
+ * extensions so that the same code compiles for SSE2, AVX2 and AVX-512 (and from C and C++).
+ * The vector width follows the compilation target unless SIMD_MATH_BYTES is given:
+ * 64 bytes with AVX-512 (8 doubles / 16 floats), 32 with AVX (4 / 8), 16 otherwise (2 / 4).
+ *
+ * Maximum error against the exact result, measured on 2 * 10^7 random arguments per function
+ * (long double libm as the reference):
+ *   simd_sin_f64   |x| < 1e8  : 2 ULP   (argument reduction by pi in four exact parts)
+ *   simd_sin_f32   |x| < 1e4  : 2.5 ULP
+ *   simd_sqrt_f64/f32         : 0.5 ULP (hardware square root)
+ *   simd_exp_f64              : 0.9 ULP
+ *   simd_log_f64              : 0.8 ULP
+ *   simd_pow_f64   x > 0      : 2 * (1 + |y * ln x|) ULP (the error of y * ln x is amplified by exp)
+ * Lanes outside these domains (large or non-finite arguments, x <= 0 for log/pow, results
+ * that overflow or underflow) are recomputed with libm, so results are always defined.
+ */
+#ifndef SIMD_MATH_BYTES
+#if defined(__AVX512F__)
+#define SIMD_MATH_BYTES 64
+#elif defined(__AVX__)
+#define SIMD_MATH_BYTES 32
+#else
+#define SIMD_MATH_BYTES 16
+#endif
+#endif
+
+#define SIMD_F64_LANES (SIMD_MATH_BYTES / 8)
+#define SIMD_F32_LANES (SIMD_MATH_BYTES / 4)
+
+typedef double simd_f64 __attribute__((vector_size(SIMD_MATH_BYTES)));
+typedef int64_t simd_i64 __attribute__((vector_size(SIMD_MATH_BYTES)));
+typedef float simd_f32 __attribute__((vector_size(SIMD_MATH_BYTES)));
+typedef int32_t simd_i32 __attribute__((vector_size(SIMD_MATH_BYTES)));
+
+/* Adding and subtracting 1.5 * 2^52 (2^23 for float) rounds to an integer, which is then
+ * also found in the low bits of the sum. */
+#define SIMD_ROUND_F64 0x1.8p52
+#define SIMD_ROUND_F32 0x1.8p23f
+#define SIMD_ROUND_BITS_F64 0x4338000000000000LL /* bit pattern of SIMD_ROUND_F64 */
+
+/* pi split into parts whose products with the quotient are exact (Cody-Waite). */
+#define SIMD_PI_A_F64 0x1.921fb54p+1
+#define SIMD_PI_B_F64 0x1.10b461p-29
+#define SIMD_PI_C_F64 0x1.a626330p-57
+#define SIMD_PI_D_F64 0x1.45c06e0e68948p-85
+#define SIMD_SIN_RANGE_F64 1e8
+
+#define SIMD_PI_A_F32 0x1.92p+1f
+#define SIMD_PI_B_F32 0x1.fb4p-11f
+#define SIMD_PI_C_F32 0x1.444p-23f
+#define SIMD_PI_D_F32 0x1.68c234p-38f
+#define SIMD_SIN_RANGE_F32 1e4f
+
+#define SIMD_1_PI 0.318309886183790671538
+#define SIMD_LOG2E 1.44269504088896340736
+#define SIMD_SQRT2 1.41421356237309504880
+#define SIMD_LN2_HI 6.93147180369123816490e-01
+#define SIMD_LN2_LO 1.90821492927058770002e-10
+
+static inline simd_f64 simd_load_f64(const double *p) {
+    simd_f64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void simd_store_f64(double *p, simd_f64 v) { memcpy(p, &v, sizeof(v)); }
+
+static inline simd_f32 simd_load_f32(const float *p) {
+    simd_f32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void simd_store_f32(float *p, simd_f32 v) { memcpy(p, &v, sizeof(v)); }
+
+/**
+ * @brief Lanes 0, 1, 2, ... as doubles / floats, for building arguments like x0 + h * (i + lane).
+ */
+static inline simd_f64 simd_iota_f64(void) {
+    simd_f64 v;
+    for (int i = 0; i < SIMD_F64_LANES; i++) v[i] = i;
+    return v;
+}
+
+static inline simd_f32 simd_iota_f32(void) {
+    simd_f32 v;
+    for (int i = 0; i < SIMD_F32_LANES; i++) v[i] = (float)i;
+    return v;
+}
+
+static inline simd_f64 simd_abs_f64(simd_f64 x) { return (simd_f64)((simd_i64)x & INT64_MAX); }
+
+static inline simd_f32 simd_abs_f32(simd_f32 x) { return (simd_f32)((simd_i32)x & INT32_MAX); }
+
+static inline simd_f64 simd_select_f64(simd_i64 mask, simd_f64 a, simd_f64 b) {
+    return (simd_f64)((mask & (simd_i64)a) | (~mask & (simd_i64)b));
+}
+
+static inline int simd_any_i64(simd_i64 mask) {
+    int64_t any = 0;
+    for (int i = 0; i < SIMD_F64_LANES; i++) any |= mask[i];
+    return any != 0;
+}
+
+static inline int simd_any_i32(simd_i32 mask) {
+    int32_t any = 0;
+    for (int i = 0; i < SIMD_F32_LANES; i++) any |= mask[i];
+    return any != 0;
+}
+
+/**
+ * @brief sin(x) on all lanes. x is reduced to d = x - q * pi, |d| <= pi / 2, and
+ *        sin(x) = (-1)^q * sin(d) with an odd minimax polynomial for sin(d).
+ */
+static inline simd_f64 simd_sin_f64(simd_f64 x) {
+    simd_f64 shifted = x * SIMD_1_PI + SIMD_ROUND_F64;
+    simd_f64 q = shifted - SIMD_ROUND_F64;
+    simd_f64 d = x - q * SIMD_PI_A_F64;
+    d = d - q * SIMD_PI_B_F64;
+    d = d - q * SIMD_PI_C_F64;
+    d = d - q * SIMD_PI_D_F64;
+
+    /* The lowest bit of the shifted sum is the parity of q. */
+    d = (simd_f64)((simd_i64)d ^ ((simd_i64)shifted << 63));
+
+    simd_f64 s = d * d;
+    simd_f64 u = s * 2.72052416138529567917983e-15 - 7.64292594113954471900203e-13;
+    u = u * s + 1.60589370117277896211623e-10;
+    u = u * s - 2.5052106814843123359368e-08;
+    u = u * s + 2.75573192104428224777379e-06;
+    u = u * s - 0.000198412698412046454654947;
+    u = u * s + 0.00833333333333318056201922;
+    u = u * s - 0.166666666666666657414808;
+    simd_f64 y = s * (u * d) + d;
+
+    simd_i64 out = ~(simd_abs_f64(x) < SIMD_SIN_RANGE_F64);
+    if (simd_any_i64(out)) {
+        for (int i = 0; i < SIMD_F64_LANES; i++)
+            if (out[i]) y[i] = sin(x[i]);
+    }
+    return y;
+}
+
+static inline simd_f32 simd_sin_f32(simd_f32 x) {
+    simd_f32 shifted = x * (float)SIMD_1_PI + SIMD_ROUND_F32;
+    simd_f32 q = shifted - SIMD_ROUND_F32;
+    simd_f32 d = x - q * SIMD_PI_A_F32;
+    d = d - q * SIMD_PI_B_F32;
+    d = d - q * SIMD_PI_C_F32;
+    d = d - q * SIMD_PI_D_F32;
+
+    d = (simd_f32)((simd_i32)d ^ ((simd_i32)shifted << 31));
+
+    simd_f32 s = d * d;
+    simd_f32 u = s * 2.6083159809786593541503e-06f - 0.0001981069071916863322258f;
+    u = u * s + 0.00833307858556509017944336f;
+    u = u * s - 0.166666597127914428710938f;
+    simd_f32 y = s * (u * d) + d;
+
+    simd_i32 out = ~(simd_abs_f32(x) < SIMD_SIN_RANGE_F32);
+    if (simd_any_i32(out)) {
+        for (int i = 0; i < SIMD_F32_LANES; i++)
+            if (out[i]) y[i] = sinf(x[i]);
+    }
+    return y;
+}
+
+/**
+ * @brief Square root on all lanes. The loop becomes one vector instruction when the
+ *        compiler may ignore errno (-fno-math-errno), otherwise one instruction per lane.
+ */
+static inline simd_f64 simd_sqrt_f64(simd_f64 x) {
+    for (int i = 0; i < SIMD_F64_LANES; i++) x[i] = __builtin_sqrt(x[i]);
+    return x;
+}
+
+static inline simd_f32 simd_sqrt_f32(simd_f32 x) {
+    for (int i = 0; i < SIMD_F32_LANES; i++) x[i] = __builtin_sqrtf(x[i]);
+    return x;
+}
+
+/**
+ * @brief exp(x) on all lanes: x = k * ln2 + r, |r| <= ln2 / 2, exp(x) = 2^k * exp(r)
+ *        with the rational approximation of exp(r) from fdlibm.
+ */
+static inline simd_f64 simd_exp_f64(simd_f64 x) {
+    simd_f64 shifted = x * SIMD_LOG2E + SIMD_ROUND_F64;
+    simd_f64 k = shifted - SIMD_ROUND_F64;
+    simd_f64 hi = x - k * SIMD_LN2_HI;
+    simd_f64 lo = k * SIMD_LN2_LO;
+    simd_f64 r = hi - lo;
+
+    simd_f64 t = r * r;
+    simd_f64 c = t * 4.13813679705723846039e-08 - 1.65339022054652515390e-06;
+    c = c * t + 6.61375632143793436117e-05;
+    c = c * t - 2.77777777770155933842e-03;
+    c = c * t + 1.66666666666666019037e-01;
+    c = r - t * c;
+    simd_f64 y = 1.0 - ((lo - (r * c) / (2.0 - c)) - hi);
+
+    /* 2^k from the low bits of the shifted sum. */
+    simd_i64 kbits = (simd_i64)shifted - SIMD_ROUND_BITS_F64;
+    y = y * (simd_f64)((kbits + 1023) << 52);
+
+    simd_i64 out = ~(simd_abs_f64(x) < 708.0);
+    if (simd_any_i64(out)) {
+        for (int i = 0; i < SIMD_F64_LANES; i++)
+            if (out[i]) y[i] = exp(x[i]);
+    }
+    return y;
+}
+
+/**
+ * @brief Natural logarithm on all lanes: x = 2^e * m, sqrt(1/2) <= m < sqrt(2),
+ *        log(x) = e * ln2 + log(m) with the series for log(m) from fdlibm.
+ */
+static inline simd_f64 simd_log_f64(simd_f64 x) {
+    const simd_i64 bits = (simd_i64)x;
+    /* Mantissa in [1, 2); values above sqrt(2) are halved and the exponent incremented. */
+    simd_f64 m = (simd_f64)((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+    simd_i64 e = ((bits >> 52) & 0x7ff) - 1023;
+    simd_i64 big = m > SIMD_SQRT2;
+    m = simd_select_f64(big, m * 0.5, m);
+    e = e - big;
+    /* Exact conversion of the small integer e to double. */
+    simd_f64 k = (simd_f64)(e + SIMD_ROUND_BITS_F64) - SIMD_ROUND_F64;
+
+    simd_f64 f = m - 1.0;
+    simd_f64 hfsq = 0.5 * f * f;
+    simd_f64 s = f / (2.0 + f);
+    simd_f64 z = s * s;
+    simd_f64 w = z * z;
+    simd_f64 t1 = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+    simd_f64 t2 = z * (6.666666666666735130e-01 +
+                       w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));
+    simd_f64 r = t2 + t1;
+    simd_f64 y = k * SIMD_LN2_HI - ((hfsq - (s * (hfsq + r) + k * SIMD_LN2_LO)) - f);
+
+    /* Zero, negative, subnormal, infinite and NaN arguments. */
+    simd_i64 out = ~((x >= DBL_MIN) & (x <= DBL_MAX));
+    if (simd_any_i64(out)) {
+        for (int i = 0; i < SIMD_F64_LANES; i++)
+            if (out[i]) y[i] = log(x[i]);
+    }
+    return y;
+}
+
+/**
+ * @brief x^y on all lanes as exp(y * log(x)); lanes with x <= 0 or a non-finite
+ *        argument or result are computed by libm pow.
+ */
+static inline simd_f64 simd_pow_f64(simd_f64 x, simd_f64 y) {
+    simd_f64 t = y * simd_log_f64(x);
+    simd_f64 r = simd_exp_f64(t);
+
+    simd_i64 out = ~((x >= DBL_MIN) & (x <= DBL_MAX) & (simd_abs_f64(t) < 708.0));
+    if (simd_any_i64(out)) {
+        for (int i = 0; i < SIMD_F64_LANES; i++)
+            if (out[i]) r[i] = pow(x[i], y[i]);
+    }
+    return r;
+}
+
+/**
+ * @brief y[i] = sin(x[i]) for i < n; whole vectors first, the tail through libm.
+ */
+static inline void simd_sin_array_f64(const double *x, double *y, size_t n) {
+    size_t i = 0;
+    for (; i + SIMD_F64_LANES <= n; i += SIMD_F64_LANES) simd_store_f64(y + i, simd_sin_f64(simd_load_f64(x + i)));
+    for (; i < n; i++) y[i] = sin(x[i]);
+}
+
+static inline void simd_sin_array_f32(const float *x, float *y, size_t n) {
+    size_t i = 0;
+    for (; i + SIMD_F32_LANES <= n; i += SIMD_F32_LANES) simd_store_f32(y + i, simd_sin_f32(simd_load_f32(x + i)));
+    for (; i < n; i++) y[i] = sinf(x[i]);
+}
+
+#endif /* COMMON_SIMD_MATH_H */
@@ -1,28 +1,263 @@
 #include <vector>
+#include <algorithm>
+#include <cctype>
+#include <memory>
 #include <cmath>
+#include <cstring>
+#include <cstdlib>
 #include <iostream>
-#include <numeric>
-#include <ctime>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <chrono>
+#include "simd_math.h"
 
-#ifdef USE_DOUBLE
-    typedef double my_type;
-#elif defined(USE_FLOAT)
-    typedef float my_type;
-#else
-    #error "It is necessary to determine DOUBLE or FLOAT."
-#endif
+/*
+ * Fills arr[i] = sin(i * pi / n) for i < n and sums the array; the element type is chosen
+ * at run time (--type float|double|both). The array is split between threads, each
+ * thread fills and sums its own part, and the partial sums are combined with compensation.
+ */
 
-int main() {
-    unsigned int start_time =  clock();
+// Elements per reseed of the angle-addition recurrence.
+constexpr size_t kChunk = 4096;
+// Upper bound of --threads.
+constexpr unsigned kMaxThreads = 1024;
 
-    std::vector <my_type> arr(10000000);
+enum class FillMode { Recurrence, Simd, Libm };
+enum class SumMode { Kahan, Naive };
 
-    for (size_t i = 0 ; i<arr.size(); i++) {
-        arr[i] = sin(i * M_PI / arr.size());
+struct Options {
+    size_t size = 10000000;
+    unsigned threads = std::thread::hardware_concurrency();
+    std::string type = "both";
+    FillMode fill = FillMode::Recurrence;
+    SumMode sum = SumMode::Kahan;
+};
+
+/**
+ * Running sum with the error of each addition kept in a separate term (Kahan).
+ * V is a scalar or a simd vector, so a whole vector of independent sums is updated at once.
+ */
+template <typename V>
+struct KahanSum {
+    V sum{};
+    V comp{};
+
+    void add(V x) {
+        V y = x - comp;
+        V t = sum + y;
+        comp = (t - sum) - y;
+        sum = t;
+    }
+};
+
+// simd vector of T from simd_math.h.
+template <typename T>
+struct SimdOf;
+
+template <>
+struct SimdOf<double> {
+    using type = simd_f64;
+};
+
+template <>
+struct SimdOf<float> {
+    using type = simd_f32;
+};
+
+/**
+ * Fills arr[i] = sin(i * h) for i in [lb, ub) with the angle-addition recurrence
+ * sin(x + d) = sin x cos d + cos x sin d, cos(x + d) = cos x cos d - sin x sin d.
+ * SIMD_F64_LANES interleaved recurrences (lane j takes elements j, j + L, ...) run in double
+ * and are reseeded from libm every kChunk elements, so the error does not accumulate.
+ */
+template <typename T>
+void FillRecurrence(T *arr, size_t lb, size_t ub, double h) {
+    constexpr int L = SIMD_F64_LANES;
+    const double cd = std::cos(L * h), sd = std::sin(L * h);
+    for (size_t c0 = lb; c0 < ub; c0 += kChunk) {
+        const size_t c1 = std::min(c0 + kChunk, ub);
+        simd_f64 s, c;
+        for (int j = 0; j < L; j++) {
+            s[j] = std::sin((c0 + j) * h);
+            c[j] = std::cos((c0 + j) * h);
+        }
+        size_t i = c0;
+        for (; i + L <= c1; i += L) {
+            for (int j = 0; j < L; j++) arr[i + j] = static_cast<T>(s[j]);
+            simd_f64 s_next = s * cd + c * sd;
+            c = c * cd - s * sd;
+            s = s_next;
+        }
+        for (int j = 0; i < c1; i++, j++) arr[i] = static_cast<T>(s[j]);
+    }
+}
+
+void FillSimd(double *arr, size_t lb, size_t ub, double h) {
+    const simd_f64 iota = simd_iota_f64();
+    size_t i = lb;
+    for (; i + SIMD_F64_LANES <= ub; i += SIMD_F64_LANES)
+        simd_store_f64(arr + i, simd_sin_f64((iota + static_cast<double>(i)) * h));
+    for (; i < ub; i++) arr[i] = std::sin(i * h);
+}
+
+void FillSimd(float *arr, size_t lb, size_t ub, double h) {
+    const simd_f32 iota = simd_iota_f32();
+    const float hf = static_cast<float>(h);
+    size_t i = lb;
+    for (; i + SIMD_F32_LANES <= ub; i += SIMD_F32_LANES)
+        simd_store_f32(arr + i, simd_sin_f32((iota + static_cast<float>(i)) * hf));
+    for (; i < ub; i++) arr[i] = std::sin(i * h);
+}
+
+template <typename T>
+void FillLibm(T *arr, size_t lb, size_t ub, double h) {
+    for (size_t i = lb; i < ub; i++) arr[i] = std::sin(i * h);
+}
+
+/**
+ * Sum of arr[lb..ub) in T, with compensation or plainly in order. Compensated sums run in
+ * simd lanes and the lanes are combined with compensation as well.
+ */
+template <typename T>
+KahanSum<T> SumRange(const T *arr, size_t lb, size_t ub, SumMode mode) {
+    KahanSum<T> total;
+    if (mode == SumMode::Naive) {
+        for (size_t i = lb; i < ub; i++) total.sum += arr[i];
+        return total;
+    }
+
+    using V = typename SimdOf<T>::type;
+    constexpr size_t L = sizeof(V) / sizeof(T);
+    KahanSum<V> lanes;
+    size_t i = lb;
+    for (; i + L <= ub; i += L) {
+        V x;
+        std::memcpy(&x, arr + i, sizeof(x));
+        lanes.add(x);
+    }
+    for (size_t j = 0; j < L; j++) {
+        total.add(lanes.sum[j]);
+        total.add(-lanes.comp[j]);
     }
+    for (; i < ub; i++) total.add(arr[i]);
+    return total;
+}
+
+/**
+ * Fills and sums an array of n elements of type T on opts.threads threads.
+ * @return wall time in seconds; sum receives the total.
+ */
+template <typename T>
+double Run(const Options &opts, T &sum) {
+    const size_t n = opts.size;
+    const double h = M_PI / n;
+    const unsigned nthreads = std::max(1u, opts.threads);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Elements are not value-initialized: each thread writes its part first (first touch).
+    std::unique_ptr<T[]> arr(new T[n]);
+    std::vector<KahanSum<T>> partial(nthreads);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < nthreads; t++) {
+        threads.emplace_back([&, t] {
+            size_t lb = n / nthreads * t;
+            size_t ub = (t == nthreads - 1) ? n : lb + n / nthreads;
+            switch (opts.fill) {
+                case FillMode::Recurrence: FillRecurrence(arr.get(), lb, ub, h); break;
+                case FillMode::Simd: FillSimd(arr.get(), lb, ub, h); break;
+                case FillMode::Libm: FillLibm(arr.get(), lb, ub, h); break;
+            }
+            partial[t] = SumRange(arr.get(), lb, ub, opts.sum);
+        });
+    }
+    for (std::thread &thread : threads) thread.join();
+
+    KahanSum<T> total;
+    for (const KahanSum<T> &p : partial) {
+        total.add(p.sum);
+        total.add(-p.comp);
+    }
+    sum = total.sum;
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+template <typename T>
+void Report(const char *name, const Options &opts) {
+    T sum;
+    double time = Run(opts, sum);
+    // sum_{i<n} sin(i * pi / n) = cot(pi / (2n)).
+    const long double exact = 1.0L / std::tan(static_cast<long double>(M_PI) / (2.0L * opts.size));
+    std::cout << std::setprecision(10);
+    std::cout << name << ":" << std::endl;
+    std::cout << "time: " << time << std::endl;
+    std::cout << "sum: " << sum << std::endl;
+    std::cout << "relative error: " << static_cast<double>(std::fabs(sum - exact) / exact) << std::endl;
+}
+
+void Usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [--type float|double|both] [--threads N] [--size N]"
+              << " [--fill recurrence|simd|libm] [--sum kahan|naive]" << std::endl;
+    std::exit(1);
+}
+
+/**
+ * @brief Parses a decimal count in [min, max]. A sign, trailing characters or a value out of
+ *        range print the usage.
+ */
+unsigned long long ParseCount(const char *prog, const std::string &value, unsigned long long min,
+                              unsigned long long max) {
+    if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0]))) Usage(prog);
+    size_t pos = 0;
+    unsigned long long count = 0;
+    try {
+        count = std::stoull(value, &pos);
+    } catch (const std::invalid_argument &) {
+        Usage(prog);
+    } catch (const std::out_of_range &) {
+        Usage(prog);
+    }
+    if (pos != value.size() || count < min || count > max) Usage(prog);
+    return count;
+}
+
+Options ParseOptions(int argc, char *argv[]) {
+    Options opts;
+    for (int i = 1; i < argc; i++) {
+        std::string key = argv[i];
+        if (i + 1 >= argc) Usage(argv[0]);
+        std::string value = argv[++i];
+        if (key == "--type" && (value == "float" || value == "double" || value == "both")) {
+            opts.type = value;
+        } else if (key == "--threads") {
+            opts.threads = ParseCount(argv[0], value, 1, kMaxThreads);
+        } else if (key == "--size") {
+            // The reference sum cot(pi / 2n) is 0 for n = 1, so at least two elements
+            opts.size = ParseCount(argv[0], value, 2, std::numeric_limits<size_t>::max() / sizeof(double));
+        } else if (key == "--fill" && value == "recurrence") {
+            opts.fill = FillMode::Recurrence;
+        } else if (key == "--fill" && value == "simd") {
+            opts.fill = FillMode::Simd;
+        } else if (key == "--fill" && value == "libm") {
+            opts.fill = FillMode::Libm;
+        } else if (key == "--sum" && (value == "kahan" || value == "naive")) {
+            opts.sum = value == "kahan" ? SumMode::Kahan : SumMode::Naive;
+        } else {
+            Usage(argv[0]);
+        }
+    }
+    return opts;
+}
 
-    unsigned int end_time = clock();
+int main(int argc, char *argv[]) {
+    Options opts = ParseOptions(argc, argv);
+    std::cout << "size: " << opts.size << ", threads: " << std::max(1u, opts.threads) << std::endl;
 
-    std::cout << "time: " << 1.0 * (end_time - start_time)/ CLOCKS_PER_SEC << std::endl;
-    std::cout << "sum: " << std::accumulate(arr.begin(), arr.end(), static_cast<my_type>(0)) << std::endl;
+    if (opts.type != "double") Report<float>("float", opts);
+    if (opts.type != "float") Report<double>("double", opts);
 }
@@ -0,0 +1,321 @@
+#ifndef BACKENDS_H
+#define BACKENDS_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <omp.h>
+#include "tree_barrier.h"
+
+/*
+ * Backends the iterative solver runs its kernels on. The solver is one function executed
+ * through Run(); inside it every kernel is a For or ForSum over the rows [0, n), which
+ * returns when all rows are done, so consecutive kernels need no other synchronization.
+ * Fork-join backends run the solver on the calling thread and hand every kernel to their
+ * threads. The persistent-region backend runs the solver on every thread of one parallel
+ * region: its local state is replicated and stays identical, since every thread gets the
+ * same sums, and kernels only synchronize at their end.
+ */
+
+/**
+ * @brief Non-owning reference to a callable long double(int begin, int end) over the rows
+ *        [begin, end). Unlike std::function it never allocates, so passing a kernel is free.
+ */
+class RangeSum {
+public:
+    template <class F>
+    RangeSum(const F &f)
+        : object_(&f), call_([](const void *object, int begin, int end) -> long double {
+              return (*static_cast<const F *>(object))(begin, end);
+          }) {}
+
+    long double operator()(int begin, int end) const { return call_(object_, begin, end); }
+
+private:
+    const void *object_;
+    long double (*call_)(const void *, int, int);
+};
+
+class ParallelBackend {
+public:
+    explicit ParallelBackend(int nthreads) : nthreads_(nthreads) {}
+    virtual ~ParallelBackend() = default;
+
+    int Threads() const { return nthreads_; }
+    virtual const char *Name() const = 0;
+
+    /**
+     * @brief Executes the solver, on the calling thread unless the backend says otherwise.
+     */
+    virtual void Run(const std::function<void()> &solve) { solve(); }
+
+    /**
+     * @brief true on the one thread that should publish the results of Run.
+     */
+    virtual bool Leader() const { return true; }
+
+    /**
+     * @brief Sum of body(begin, end) over a partition of [0, n) into ranges, computed in parallel.
+     */
+    virtual long double ForSum(int n, RangeSum body) = 0;
+
+    /**
+     * @brief body(begin, end) over a partition of [0, n) into ranges, in parallel.
+     */
+    template <class F>
+    void For(int n, const F &body) {
+        ForSum(n, [&](int begin, int end) {
+            body(begin, end);
+            return 0.0L;
+        });
+    }
+
+protected:
+    /**
+     * @brief Part `part` of [0, n) split into `parts` ranges of sizes differing by at most one.
+     */
+    static void StaticRange(int n, int parts, int part, int &begin, int &end) {
+        begin = static_cast<int>(static_cast<long long>(n) * part / parts);
+        end = static_cast<int>(static_cast<long long>(n) * (part + 1) / parts);
+    }
+
+    int nthreads_;
+};
+
+/**
+ * @brief A parallel for over the threads for every kernel (as task3_metod_1).
+ */
+class OmpForBackend : public ParallelBackend {
+public:
+    using ParallelBackend::ParallelBackend;
+
+    const char *Name() const override { return "omp-for"; }
+
+    long double ForSum(int n, RangeSum body) override {
+        long double sum = 0.0;
+        #pragma omp parallel for num_threads(nthreads_) schedule(static) reduction(+:sum)
+        for (int part = 0; part < nthreads_; part++) {
+            int begin, end;
+            StaticRange(n, nthreads_, part, begin, end);
+            if (begin < end) sum += body(begin, end);
+        }
+        return sum;
+    }
+};
+
+/**
+ * @brief The whole solver in one parallel region (as task3_metod_2); every thread keeps its
+ *        own rows and kernels end with a TreeAllReduce.
+ */
+class OmpRegionBackend : public ParallelBackend {
+public:
+    explicit OmpRegionBackend(int nthreads) : ParallelBackend(nthreads), allReduce_(nthreads) {}
+
+    const char *Name() const override { return "omp-region"; }
+
+    void Run(const std::function<void()> &solve) override {
+        #pragma omp parallel num_threads(nthreads_)
+        solve();
+    }
+
+    bool Leader() const override { return omp_get_thread_num() == 0; }
+
+    long double ForSum(int n, RangeSum body) override {
+        int threadId = omp_get_thread_num();
+        int begin, end;
+        StaticRange(n, nthreads_, threadId, begin, end);
+        return allReduce_.Sum(threadId, begin < end ? body(begin, end) : 0.0L);
+    }
+
+private:
+    TreeAllReduce<long double> allReduce_;
+};
+
+/**
+ * @brief Persistent std::thread workers; the calling thread is worker 0. A kernel is handed
+ *        out by advancing an epoch the workers wait on (spinning, then sleeping on a condition
+ *        variable; with more threads than cores they sleep at once), and collected when all
+ *        workers have counted themselves done.
+ */
+class PoolBackend : public ParallelBackend {
+public:
+    explicit PoolBackend(int nthreads) : ParallelBackend(nthreads), partials_(new Partial[nthreads]) {
+        spins_ = static_cast<unsigned>(nthreads) <= std::thread::hardware_concurrency() ? kSpinsBeforeYield : 0;
+        for (int worker = 1; worker < nthreads; worker++)
+            workers_.emplace_back([this, worker] { Loop(worker); });
+    }
+
+    ~PoolBackend() override {
+        stop_ = true;
+        Dispatch();
+        for (std::thread &worker : workers_) worker.join();
+    }
+
+    long double ForSum(int n, RangeSum body) override {
+        job_ = &body;
+        jobSize_ = n;
+        Prepare(n);
+        done_.store(0, std::memory_order_relaxed);
+        Dispatch();
+
+        partials_[0].value = Work(0);
+        SpinUntil([&] { return done_.load(std::memory_order_acquire) == nthreads_ - 1; }, spins_);
+
+        long double sum = 0.0;
+        for (int worker = 0; worker < nthreads_; worker++) sum += partials_[worker].value;
+        return sum;
+    }
+
+protected:
+    /**
+     * @brief Called on the calling thread before a kernel of n rows is handed out.
+     */
+    virtual void Prepare(int n) { (void)n; }
+
+    /**
+     * @brief Share of the current kernel computed by `worker`; returns its partial sum.
+     */
+    virtual long double Work(int worker) = 0;
+
+    const RangeSum *job_ = nullptr;
+    int jobSize_ = 0;
+
+private:
+    struct alignas(64) Partial {
+        long double value = 0.0;
+    };
+
+    void Dispatch() {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_.notify_all();
+        }
+    }
+
+    /**
+     * @brief Waits until the epoch differs from `seen`: spins first, then sleeps.
+     */
+    void WaitForEpoch(unsigned seen) {
+        for (int spins = 0; spins < spins_; spins++) {
+            if (epoch_.load(std::memory_order_acquire) != seen) return;
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        wakeup_.wait(lock, [&] { return epoch_.load(std::memory_order_seq_cst) != seen; });
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void Loop(int worker) {
+        unsigned seen = 0;
+        while (true) {
+            WaitForEpoch(seen);
+            seen = epoch_.load(std::memory_order_acquire);
+            if (stop_) return;
+            partials_[worker].value = Work(worker);
+            done_.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    std::unique_ptr<Partial[]> partials_;
+    std::vector<std::thread> workers_;
+    int spins_;
+    std::atomic<bool> stop_{false};
+    alignas(64) std::atomic<unsigned> epoch_{0};
+    alignas(64) std::atomic<int> done_{0};
+    std::atomic<int> sleepers_{0};
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+};
+
+/**
+ * @brief Thread pool with a static range per worker.
+ */
+class ThreadPoolBackend : public PoolBackend {
+public:
+    using PoolBackend::PoolBackend;
+
+    const char *Name() const override { return "pool"; }
+
+protected:
+    long double Work(int worker) override {
+        int begin, end;
+        StaticRange(jobSize_, nthreads_, worker, begin, end);
+        return begin < end ? (*job_)(begin, end) : 0.0L;
+    }
+};
+
+/**
+ * @brief Thread pool with work stealing: the rows are cut into chunks, every worker starts
+ *        with a contiguous queue of chunks and, once it is empty, takes chunks from the
+ *        queues of the others. Queues are atomic counters, one cache line each.
+ */
+class WorkStealingBackend : public PoolBackend {
+public:
+    explicit WorkStealingBackend(int nthreads) : PoolBackend(nthreads), queues_(new Queue[nthreads]) {}
+
+    const char *Name() const override { return "stealing"; }
+
+protected:
+    // Chunks per worker, and the smallest chunk in rows.
+    static constexpr int kChunksPerWorker = 8;
+    static constexpr int kMinChunk = 256;
+
+    void Prepare(int n) override {
+        chunk_ = std::max(kMinChunk, n / (nthreads_ * kChunksPerWorker));
+        int chunks = (n + chunk_ - 1) / chunk_;
+        for (int worker = 0; worker < nthreads_; worker++) {
+            int begin, end;
+            StaticRange(chunks, nthreads_, worker, begin, end);
+            queues_[worker].next.store(begin, std::memory_order_relaxed);
+            queues_[worker].end = end;
+        }
+    }
+
+    long double Work(int worker) override {
+        long double sum = 0.0;
+        for (int i = 0; i < nthreads_; i++) {
+            Queue &queue = queues_[(worker + i) % nthreads_];
+            for (int c; (c = queue.next.fetch_add(1, std::memory_order_relaxed)) < queue.end;)
+                sum += (*job_)(c * chunk_, std::min(jobSize_, (c + 1) * chunk_));
+        }
+        return sum;
+    }
+
+private:
+    struct alignas(64) Queue {
+        std::atomic<int> next{0};
+        int end = 0;
+    };
+
+    std::unique_ptr<Queue[]> queues_;
+    int chunk_ = kMinChunk;
+};
+
+/**
+ * @brief Names accepted by MakeBackend.
+ */
+inline const std::vector<std::string> &BackendNames() {
+    static const std::vector<std::string> names = {"omp-for", "omp-region", "pool", "stealing"};
+    return names;
+}
+
+inline std::unique_ptr<ParallelBackend> MakeBackend(const std::string &name, int nthreads) {
+    if (name == "omp-for") return std::make_unique<OmpForBackend>(nthreads);
+    if (name == "omp-region") return std::make_unique<OmpRegionBackend>(nthreads);
+    if (name == "pool") return std::make_unique<ThreadPoolBackend>(nthreads);
+    if (name == "stealing") return std::make_unique<WorkStealingBackend>(nthreads);
+    throw std::invalid_argument("Unknown backend: " + name + " (omp-for, omp-region, pool or stealing)");
+}
+
+#endif  // BACKENDS_H
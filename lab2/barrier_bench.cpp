@@ -0,0 +1,94 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <omp.h>
+#include "tree_barrier.h"
+
+/*
+ * Latency of one barrier + sum over the threads (all-reduce) in a persistent parallel region:
+ * the OpenMP pattern task3_metod_2 used (atomic, barrier, single) and a reduction loop against
+ * TreeAllReduce, for 1, 2, 4, ... threads up to argv[1] (default 64).
+ */
+
+/**
+ * @brief Runs `rounds` all-reduces of threadId + 1 on nthreads threads with sum(threadId, value)
+ *        and returns the time per round in nanoseconds. Exits if a total is wrong.
+ */
+template <class Sum>
+double TimeRounds(int nthreads, int rounds, Sum sum) {
+    const long double expected = nthreads * (nthreads + 1) / 2.0L;
+    std::atomic<bool> wrong{false};
+    double start = omp_get_wtime();
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int threadId = omp_get_thread_num();
+        for (int r = 0; r < rounds; r++) {
+            if (sum(threadId, threadId + 1.0L) != expected) wrong = true;
+        }
+    }
+
+    double time = omp_get_wtime() - start;
+    if (wrong) {
+        std::fprintf(stderr, "Error: wrong sum with %d threads\n", nthreads);
+        std::exit(1);
+    }
+    return time / rounds * 1e9;
+}
+
+/**
+ * @brief Each thread adds its value atomically, a barrier waits for all of them, every thread
+ *        reads the total and a single section resets it (with its implicit barrier).
+ */
+double TimeOmp(int nthreads, int rounds) {
+    long double total = 0.0;
+    return TimeRounds(nthreads, rounds, [&](int, long double value) {
+        #pragma omp atomic
+        total += value;
+        #pragma omp barrier
+        long double result = total;
+        #pragma omp barrier
+        #pragma omp single
+        total = 0.0;
+        return result;
+    });
+}
+
+/**
+ * @brief The same with OpenMP's own reduction of a worksharing loop, one iteration per thread.
+ */
+double TimeOmpReduction(int nthreads, int rounds) {
+    long double total = 0.0;
+    return TimeRounds(nthreads, rounds, [&](int threadId, long double value) {
+        #pragma omp single
+        total = 0.0;
+        #pragma omp for schedule(static) reduction(+ : total)
+        for (int t = 0; t < nthreads; t++)
+            total += (t == threadId) ? value : 0.0L;
+        long double result = total;
+        // Everybody has read the total before the next round resets it
+        #pragma omp barrier
+        return result;
+    });
+}
+
+double TimeTree(int nthreads, int rounds) {
+    TreeAllReduce<long double> allReduce(nthreads);
+    return TimeRounds(nthreads, rounds, [&](int threadId, long double value) { return allReduce.Sum(threadId, value); });
+}
+
+int main(int argc, char *argv[]) {
+    int maxThreads = (argc > 1) ? std::atoi(argv[1]) : 64;
+    omp_set_dynamic(0);
+
+    std::printf("barrier + sum over the threads, ns per round\n");
+    std::printf("%8s %18s %18s %18s\n", "threads", "omp atomic+barrier", "omp for reduction", "tree all-reduce");
+    for (int nthreads = 1; nthreads <= maxThreads; nthreads *= 2) {
+        int rounds = 200000 / nthreads;
+        // Warm-up: creates the team of this size
+        TimeOmp(nthreads, 100);
+        std::printf("%8d %18.0f %18.0f %18.0f\n", nthreads, TimeOmp(nthreads, rounds),
+                    TimeOmpReduction(nthreads, rounds), TimeTree(nthreads, rounds));
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+#ifndef ITERATIVE_SOLVER_H
+#define ITERATIVE_SOLVER_H
+
+#include <cmath>
+#include <vector>
+#include <omp.h>
+#include "backends.h"
+#include "operators.h"
+#include "spectrum.h"
+
+/*
+ * The task3 simple iteration (fixed step, automatic step or Chebyshev semi-iteration) written
+ * once, for any scalar type, any operator storage and any backend; sizes and threads are
+ * run-time parameters. task3_metod_1/2 run it with MATRIX_SIZE and NTHREADS fixed at compile
+ * time, on the omp-for and omp-region backends.
+ */
+
+struct SolverOptions {
+    IterationKind kind = IterationKind::Fixed;
+    // Stop when ||A x - b|| < epsilon * ||b||
+    long double epsilon = 1e-5;
+    // Step of IterationKind::Fixed
+    long double step = 1e-5;
+    int maxIterations = 10000000;
+};
+
+struct SolverResult {
+    int iterations = 0;
+    bool converged = false;
+    // ||A x - b|| / ||b|| after the last iteration
+    long double residual = 0.0;
+    SpectrumEstimate spectrum{0.0, 0.0, 0};
+    // Spectrum estimation (OpenMP on backend.Threads() threads) and the iterations
+    double setupSeconds = 0.0;
+    double seconds = 0.0;
+};
+
+/**
+ * @brief Solves a x = b by simple iteration from the initial guess in x.
+ *        Every kernel (the operator reduction, the product with the residual norm and the
+ *        update of x) is one backend call, so all backends run exactly the same arithmetic.
+ */
+template <class T>
+SolverResult SolveSimpleIteration(const BasicLinearOperator<T> &a, const std::vector<T> &b, std::vector<T> &x,
+                                  ParallelBackend &backend, const SolverOptions &options) {
+    const int n = a.Size();
+    std::vector<T> residual(n), direction(n, T(0));
+    SolverResult result;
+
+    // residual = A x - b and its squared norm; the reduction over x first, if the operator needs it
+    auto computeResidual = [&]() {
+        long double reduction = 0.0;
+        if (a.NeedsReduction())
+            reduction = backend.ForSum(n, [&](int begin, int end) { return a.PartialReduction(x.data(), begin, end - 1); });
+        return backend.ForSum(n, [&](int begin, int end) {
+            a.ApplyRows(x.data(), residual.data(), begin, end - 1, reduction);
+            long double sum = 0.0;
+            for (int i = begin; i < end; i++) {
+                residual[i] -= b[i];
+                sum += static_cast<long double>(residual[i]) * residual[i];
+            }
+            return sum;
+        });
+    };
+
+    double setupStart = omp_get_wtime();
+    long double step = options.step;
+    if (options.kind != IterationKind::Fixed) {
+        // Spectrum seen by the initial residual b - A x0
+        backend.Run([&] { computeResidual(); });
+        std::vector<T> r0(n);
+        for (int i = 0; i < n; i++) r0[i] = -residual[i];
+        result.spectrum = EstimateSpectrum(a, r0, backend.Threads());
+        step = 2.0L / (result.spectrum.lambdaMin + result.spectrum.lambdaMax);
+    }
+    const ChebyshevCoefficients chebyshev(result.spectrum);
+    result.setupSeconds = omp_get_wtime() - setupStart;
+
+    double start = omp_get_wtime();
+    backend.Run([&] {
+        // Replicated on every thread of a persistent region; identical everywhere.
+        ChebyshevCoefficients coefficients = chebyshev;
+        const long double normB = std::sqrt(backend.ForSum(n, [&](int begin, int end) {
+            long double sum = 0.0;
+            for (int i = begin; i < end; i++) sum += static_cast<long double>(b[i]) * b[i];
+            return sum;
+        }));
+
+        int iterations = 0;
+        bool converged = false;
+        long double norm = 0.0;
+        while (true) {
+            norm = std::sqrt(computeResidual());
+            iterations++;
+            if (norm < options.epsilon * normB) {
+                converged = true;
+                break;
+            }
+            if (iterations >= options.maxIterations) break;
+
+            if (options.kind == IterationKind::Chebyshev) {
+                // direction = previous * direction - residual * (A x - b), x += direction
+                coefficients.Next(iterations - 1);
+                const T previous = static_cast<T>(coefficients.Previous());
+                const T scale = static_cast<T>(coefficients.Residual());
+                backend.For(n, [&](int begin, int end) {
+                    for (int i = begin; i < end; i++) {
+                        direction[i] = previous * direction[i] - scale * residual[i];
+                        x[i] += direction[i];
+                    }
+                });
+            } else {
+                const T tau = static_cast<T>(step);
+                backend.For(n, [&](int begin, int end) {
+                    for (int i = begin; i < end; i++) x[i] -= tau * residual[i];
+                });
+            }
+        }
+
+        if (backend.Leader()) {
+            result.iterations = iterations;
+            result.converged = converged;
+            result.residual = normB > 0 ? norm / normB : norm;
+        }
+    });
+    result.seconds = omp_get_wtime() - start;
+    return result;
+}
+
+#endif  // ITERATIVE_SOLVER_H
@@ -0,0 +1,253 @@
+#ifndef OPERATORS_H
+#define OPERATORS_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "arena.h"
+
+/*
+ * Matrix of the task3 linear system behind one interface, so the iteration solvers do not
+ * depend on how it is stored. Rows are applied in ranges [lowerBound, upperBound] (inclusive,
+ * as in the solvers), which fits both a parallel for and a persistent parallel region.
+ * Entries and vectors are of type T; reductions are accumulated in long double. The
+ * long double operators the task3 programs use have the plain names (LinearOperator, ...).
+ */
+template <class T>
+class BasicLinearOperator {
+public:
+    using Scalar = T;
+
+    explicit BasicLinearOperator(int n) : n_(n) {}
+    virtual ~BasicLinearOperator() = default;
+
+    int Size() const { return n_; }
+    virtual const char *Name() const = 0;
+    virtual std::size_t MemoryBytes() const = 0;
+
+    /**
+     * @brief true if ApplyRows needs the sum of PartialReduction over all rows of x.
+     */
+    virtual bool NeedsReduction() const { return false; }
+
+    /**
+     * @brief Contribution of rows [lowerBound, upperBound] of x to the reduction.
+     */
+    virtual long double PartialReduction(const T *x, int lowerBound, int upperBound) const {
+        (void)x, (void)lowerBound, (void)upperBound;
+        return 0.0;
+    }
+
+    /**
+     * @brief y[i] = (A * x)[i] for i in [lowerBound, upperBound].
+     * @param reduction Sum of PartialReduction(x) over all rows (ignored if not NeedsReduction()).
+     */
+    virtual void ApplyRows(const T *x, T *y, int lowerBound, int upperBound, long double reduction) const = 0;
+
+    /**
+     * @brief y = A * x on nthreads threads: the reduction (if any), then the rows.
+     */
+    void Apply(const T *x, T *y, int nthreads) const {
+        long double reduction = 0.0;
+        if (NeedsReduction()) {
+            #pragma omp parallel num_threads(nthreads) reduction(+:reduction)
+            {
+                int lowerBound, upperBound;
+                ThreadRows(lowerBound, upperBound);
+                reduction += PartialReduction(x, lowerBound, upperBound);
+            }
+        }
+
+        #pragma omp parallel num_threads(nthreads)
+        {
+            int lowerBound, upperBound;
+            ThreadRows(lowerBound, upperBound);
+            ApplyRows(x, y, lowerBound, upperBound, reduction);
+        }
+    }
+
+protected:
+    /**
+     * @brief Rows [lowerBound, upperBound] of the calling thread of the current team.
+     */
+    void ThreadRows(int &lowerBound, int &upperBound) const {
+        int numThreads = omp_get_num_threads();
+        int threadId = omp_get_thread_num();
+        int itemsPerThread = n_ / numThreads;
+        lowerBound = threadId * itemsPerThread;
+        upperBound = (threadId == numThreads - 1) ? (n_ - 1) : (lowerBound + itemsPerThread - 1);
+    }
+
+    int n_;
+};
+
+using LinearOperator = BasicLinearOperator<long double>;
+
+/**
+ * @brief Dense row-major n x n matrix, O(n^2) per product. The reference implementation.
+ *        The entries live in an arena on transparent huge pages (fewer TLB misses on the
+ *        n^2 sweep of every product).
+ */
+template <class T>
+class BasicDenseOperator : public BasicLinearOperator<T> {
+    using BasicLinearOperator<T>::n_;
+
+public:
+    /**
+     * @param entry a(i, j); rows are filled by the threads that later multiply them (first touch).
+     */
+    template <class Entry>
+    BasicDenseOperator(int n, Entry entry, int nthreads) : BasicLinearOperator<T>(n) {
+        const std::size_t bytes = std::size_t(n) * n * sizeof(T);
+        if (arena_init(&arena_, bytes, ARENA_PAGES_TRANSPARENT) != 0) throw std::bad_alloc();
+        data_ = static_cast<T *>(arena_alloc(&arena_, bytes, 64));
+        #pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++)
+                data_[std::size_t(i) * n + j] = entry(i, j);
+        }
+    }
+
+    ~BasicDenseOperator() override { arena_release(&arena_); }
+
+    BasicDenseOperator(const BasicDenseOperator &) = delete;
+    BasicDenseOperator &operator=(const BasicDenseOperator &) = delete;
+
+    const char *Name() const override { return "dense"; }
+    std::size_t MemoryBytes() const override { return std::size_t(n_) * n_ * sizeof(T); }
+
+    void ApplyRows(const T *x, T *y, int lowerBound, int upperBound, long double) const override {
+        for (int i = lowerBound; i <= upperBound; i++) {
+            const T *row = data_ + std::size_t(i) * n_;
+            T sum = 0;
+            for (int j = 0; j < n_; j++)
+                sum += row[j] * x[j];
+            y[i] = sum;
+        }
+    }
+
+private:
+    Arena arena_;
+    T *data_;
+};
+
+using DenseOperator = BasicDenseOperator<long double>;
+
+/**
+ * @brief Compressed sparse rows: only non-zero entries are stored, O(nnz) per product.
+ */
+template <class T>
+class BasicCsrOperator : public BasicLinearOperator<T> {
+    using BasicLinearOperator<T>::n_;
+
+public:
+    /**
+     * @param entry a(i, j); zero entries are skipped. Built in two parallel passes
+     *        (count per row, then fill), so the pattern is never held densely.
+     */
+    template <class Entry>
+    BasicCsrOperator(int n, Entry entry, int nthreads) : BasicLinearOperator<T>(n), rowPtr_(std::size_t(n) + 1, 0) {
+        #pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (int i = 0; i < n; i++) {
+            std::size_t count = 0;
+            for (int j = 0; j < n; j++)
+                count += entry(i, j) != 0;
+            rowPtr_[i + 1] = count;
+        }
+        for (int i = 0; i < n; i++)
+            rowPtr_[i + 1] += rowPtr_[i];
+
+        cols_.resize(rowPtr_[n]);
+        values_.resize(rowPtr_[n]);
+        #pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (int i = 0; i < n; i++) {
+            std::size_t k = rowPtr_[i];
+            for (int j = 0; j < n; j++) {
+                T a = entry(i, j);
+                if (a != 0) {
+                    cols_[k] = j;
+                    values_[k++] = a;
+                }
+            }
+        }
+    }
+
+    const char *Name() const override { return "csr"; }
+    std::size_t MemoryBytes() const override {
+        return rowPtr_.size() * sizeof(std::size_t) + cols_.size() * sizeof(int) + values_.size() * sizeof(T);
+    }
+
+    void ApplyRows(const T *x, T *y, int lowerBound, int upperBound, long double) const override {
+        for (int i = lowerBound; i <= upperBound; i++) {
+            T sum = 0;
+            for (std::size_t k = rowPtr_[i]; k < rowPtr_[i + 1]; k++)
+                sum += values_[k] * x[cols_[k]];
+            y[i] = sum;
+        }
+    }
+
+private:
+    std::vector<std::size_t> rowPtr_;
+    std::vector<int> cols_;
+    std::vector<T> values_;
+};
+
+using CsrOperator = BasicCsrOperator<long double>;
+
+/**
+ * @brief A = diag(d) + u * v^T, O(n) per product: y = d .* x + u * (v . x),
+ *        where v . x is the one reduction over all rows.
+ */
+template <class T>
+class BasicDiagonalPlusRankOneOperator : public BasicLinearOperator<T> {
+    using BasicLinearOperator<T>::n_;
+
+public:
+    BasicDiagonalPlusRankOneOperator(std::vector<T> d, std::vector<T> u, std::vector<T> v)
+        : BasicLinearOperator<T>(static_cast<int>(d.size())), d_(std::move(d)), u_(std::move(u)), v_(std::move(v)) {}
+
+    const char *Name() const override { return "structured"; }
+    std::size_t MemoryBytes() const override { return 3 * std::size_t(n_) * sizeof(T); }
+
+    bool NeedsReduction() const override { return true; }
+
+    long double PartialReduction(const T *x, int lowerBound, int upperBound) const override {
+        long double dot = 0;
+        for (int i = lowerBound; i <= upperBound; i++)
+            dot += static_cast<long double>(v_[i]) * x[i];
+        return dot;
+    }
+
+    void ApplyRows(const T *x, T *y, int lowerBound, int upperBound, long double reduction) const override {
+        const T dot = static_cast<T>(reduction);
+        for (int i = lowerBound; i <= upperBound; i++)
+            y[i] = d_[i] * x[i] + u_[i] * dot;
+    }
+
+private:
+    std::vector<T> d_, u_, v_;
+};
+
+using DiagonalPlusRankOneOperator = BasicDiagonalPlusRankOneOperator<long double>;
+
+/**
+ * @brief Matrix of the task3 system, 2 on the diagonal and 1 elsewhere (I + 1 * 1^T),
+ *        stored as kind = "dense", "csr" or "structured".
+ */
+template <class T = long double>
+std::unique_ptr<BasicLinearOperator<T>> MakeSystemOperator(const std::string &kind, int n, int nthreads) {
+    auto entry = [](int i, int j) -> T { return (i == j) ? 2.0 : 1.0; };
+    if (kind == "dense") return std::make_unique<BasicDenseOperator<T>>(n, entry, nthreads);
+    if (kind == "csr") return std::make_unique<BasicCsrOperator<T>>(n, entry, nthreads);
+    if (kind == "structured") {
+        std::vector<T> ones(n, 1.0);
+        return std::make_unique<BasicDiagonalPlusRankOneOperator<T>>(ones, ones, ones);
+    }
+    throw std::invalid_argument("Unknown operator: " + kind + " (dense, csr or structured)");
+}
+
+#endif  // OPERATORS_H
@@ -0,0 +1,218 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include "operators.h"
+
+/*
+ * Step-size selection for the simple iteration x -= tau * (A x - b) and the Chebyshev
+ * semi-iteration of the task3 solvers, from estimates of the extreme eigenvalues of a
+ * symmetric positive definite A.
+ */
+
+/**
+ * @brief Iteration used by the task3 solvers.
+ *        Fixed - simple iteration with kITERATION_STEP;
+ *        Auto - simple iteration with tau = 2 / (lambdaMin + lambdaMax);
+ *        Chebyshev - Chebyshev semi-iteration on [lambdaMin, lambdaMax].
+ */
+enum class IterationKind { Fixed, Auto, Chebyshev };
+
+inline IterationKind ParseIterationKind(const std::string &name) {
+    if (name == "fixed") return IterationKind::Fixed;
+    if (name == "auto") return IterationKind::Auto;
+    if (name == "chebyshev") return IterationKind::Chebyshev;
+    throw std::invalid_argument("Unknown method: " + name + " (fixed, auto or chebyshev)");
+}
+
+/**
+ * @brief Interval [lambdaMin, lambdaMax] the iteration is tuned for, and the number of
+ *        matrix-vector products spent on finding it.
+ */
+struct SpectrumEstimate {
+    long double lambdaMin;
+    long double lambdaMax;
+    int products;
+};
+
+namespace spectrum_detail {
+
+template <class T>
+long double Dot(const std::vector<T> &x, const std::vector<T> &y, int nthreads) {
+    long double sum = 0.0;
+    #pragma omp parallel for num_threads(nthreads) schedule(static) reduction(+:sum)
+    for (size_t i = 0; i < x.size(); i++)
+        sum += static_cast<long double>(x[i]) * y[i];
+    return sum;
+}
+
+/**
+ * @brief Number of eigenvalues below x of the symmetric tridiagonal matrix with diagonal
+ *        alpha and off-diagonal beta (Sturm sequence).
+ */
+inline int CountBelow(const std::vector<long double> &alpha, const std::vector<long double> &beta, long double x) {
+    int count = 0;
+    long double q = 1.0;
+    for (size_t i = 0; i < alpha.size(); i++) {
+        long double b2 = (i > 0) ? beta[i - 1] * beta[i - 1] : 0.0;
+        q = alpha[i] - x - b2 / q;
+        if (q == 0) q = 1e-300L;
+        count += q < 0;
+    }
+    return count;
+}
+
+/**
+ * @brief k-th smallest eigenvalue (0-based) of the tridiagonal matrix by bisection.
+ */
+inline long double TridiagonalEigenvalue(const std::vector<long double> &alpha, const std::vector<long double> &beta,
+                                         int k) {
+    // Gershgorin interval.
+    long double lo = alpha[0], hi = alpha[0];
+    for (size_t i = 0; i < alpha.size(); i++) {
+        long double r = (i > 0 ? std::fabs(beta[i - 1]) : 0) + (i + 1 < alpha.size() ? std::fabs(beta[i]) : 0);
+        lo = std::min(lo, alpha[i] - r);
+        hi = std::max(hi, alpha[i] + r);
+    }
+    for (int it = 0; it < 200 && hi - lo > 1e-15L * std::max(std::fabs(lo), std::fabs(hi)); it++) {
+        long double mid = 0.5L * (lo + hi);
+        if (CountBelow(alpha, beta, mid) > k)
+            hi = mid;
+        else
+            lo = mid;
+    }
+    return 0.5L * (lo + hi);
+}
+
+}  // namespace spectrum_detail
+
+/**
+ * @brief Extreme Ritz values of A after up to `steps` Lanczos steps from `start`.
+ *        The Ritz values lie inside the part of the spectrum that `start` excites,
+ *        so starting from the initial residual tunes the iteration to that residual.
+ * @param products Incremented by the number of products with A.
+ */
+template <class T>
+std::pair<long double, long double> LanczosExtremes(const BasicLinearOperator<T> &a, std::vector<T> start, int steps,
+                                                    int nthreads, int &products) {
+    using spectrum_detail::Dot;
+    const int n = a.Size();
+    std::vector<T> q(std::move(start)), qPrev(n, 0.0), w(n);
+    std::vector<long double> alpha, beta;
+
+    long double norm = std::sqrt(Dot(q, q, nthreads));
+    for (T &value : q) value /= norm;
+
+    long double betaPrev = 0.0;
+    for (int j = 0; j < steps; j++) {
+        a.Apply(q.data(), w.data(), nthreads);
+        products++;
+        long double alphaJ = Dot(q, w, nthreads);
+        #pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (int i = 0; i < n; i++)
+            w[i] -= static_cast<T>(alphaJ * q[i] + betaPrev * qPrev[i]);
+        long double betaJ = std::sqrt(Dot(w, w, nthreads));
+        alpha.push_back(alphaJ);
+
+        // The Krylov space of start is invariant: the Ritz values are exact.
+        if (betaJ <= 1e-12L * std::fabs(alphaJ)) break;
+        beta.push_back(betaJ);
+
+        #pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (int i = 0; i < n; i++) {
+            qPrev[i] = q[i];
+            q[i] = static_cast<T>(w[i] / betaJ);
+        }
+        betaPrev = betaJ;
+    }
+
+    return {spectrum_detail::TridiagonalEigenvalue(alpha, beta, 0),
+            spectrum_detail::TridiagonalEigenvalue(alpha, beta, static_cast<int>(alpha.size()) - 1)};
+}
+
+/**
+ * @brief Largest eigenvalue of A by `steps` power iterations from a pseudo-random vector
+ *        (Rayleigh quotient of the last iterate).
+ */
+template <class T>
+long double PowerIterationMax(const BasicLinearOperator<T> &a, int steps, int nthreads, int &products) {
+    using spectrum_detail::Dot;
+    const int n = a.Size();
+    std::vector<T> x(n), y(n);
+    std::mt19937_64 gen(42);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (T &value : x) value = dist(gen);
+
+    long double rayleigh = 0.0;
+    for (int it = 0; it < steps; it++) {
+        long double norm = std::sqrt(Dot(x, x, nthreads));
+        #pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (int i = 0; i < n; i++)
+            x[i] = static_cast<T>(x[i] / norm);
+        a.Apply(x.data(), y.data(), nthreads);
+        products++;
+        rayleigh = Dot(x, y, nthreads);
+        std::swap(x, y);
+    }
+    return rayleigh;
+}
+
+/**
+ * @brief Interval for the iteration on A x = b from the initial residual r0 = b - A x0:
+ *        the lower end from Lanczos on r0, the upper end from Lanczos and a power iteration
+ *        from a random vector (eigenvalues above the interval would be amplified by
+ *        Chebyshev iteration once rounding excites them). Both ends get a safety margin.
+ */
+template <class T>
+SpectrumEstimate EstimateSpectrum(const BasicLinearOperator<T> &a, const std::vector<T> &r0, int nthreads,
+                                  int steps = 20) {
+    SpectrumEstimate estimate{0.0, 0.0, 0};
+    auto [ritzMin, ritzMax] = LanczosExtremes(a, r0, steps, nthreads, estimate.products);
+    long double powerMax = PowerIterationMax(a, steps, nthreads, estimate.products);
+    estimate.lambdaMin = 0.95L * ritzMin;
+    estimate.lambdaMax = 1.05L * std::max(ritzMax, powerMax);
+    return estimate;
+}
+
+/**
+ * @brief Coefficients of the Chebyshev semi-iteration on [lambdaMin, lambdaMax]
+ *        (Saad, Iterative Methods, Alg. 12.1): with r = b - A x,
+ *        d_0 = r_0 / theta, d_k = rho_k * rho_{k-1} * d_{k-1} + 2 * rho_k / delta * r_k,
+ *        rho_k = 1 / (2 * sigma - rho_{k-1}), x += d_k.
+ */
+class ChebyshevCoefficients {
+public:
+    explicit ChebyshevCoefficients(const SpectrumEstimate &estimate)
+        : theta_(0.5L * (estimate.lambdaMax + estimate.lambdaMin)),
+          delta_(0.5L * (estimate.lambdaMax - estimate.lambdaMin)),
+          sigma_(theta_ / delta_),
+          rho_(1.0L / sigma_) {}
+
+    /**
+     * @brief Advances to iteration k; afterwards d_k = Previous() * d_{k-1} + Residual() * r_k.
+     */
+    void Next(int k) {
+        if (k == 0) {
+            previous_ = 0.0;
+            residual_ = 1.0L / theta_;
+            return;
+        }
+        long double rhoNext = 1.0L / (2.0L * sigma_ - rho_);
+        previous_ = rhoNext * rho_;
+        residual_ = 2.0L * rhoNext / delta_;
+        rho_ = rhoNext;
+    }
+
+    long double Previous() const { return previous_; }
+    long double Residual() const { return residual_; }
+
+private:
+    long double theta_, delta_, sigma_, rho_;
+    long double previous_ = 0.0, residual_ = 0.0;
+};
+
+#endif  // SPECTRUM_H
@@ -1,8 +1,18 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
 #include <omp.h>
 #include <time.h>
 #include <inttypes.h>
+#include "arena.h"
+#include "matrix_file.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
 
 #ifdef NTHREADS
 #else
@@ -14,6 +24,61 @@
 #error "MATRIX_SIZE is not defined. Please specify -DMATRIX_SIZE=value during compilation.(20000x20000 or 40000x40000)"
 #endif
 
+/* Number of matrix columns; by default the matrix is square. */
+#ifndef MATRIX_COLS
+#define MATRIX_COLS MATRIX_SIZE
+#endif
+
+/* Matrix storage type: -DUSE_FLOAT or -DUSE_BF16, double by default.
+   The vector and all sums stay in double; narrower storage only cuts
+   the matrix traffic (2x for float, 4x for bf16). */
+#if defined(USE_FLOAT)
+typedef float matrix_t;
+#define STORAGE_NAME "float"
+#elif defined(USE_BF16)
+#include "bf16.h"
+typedef bf16_t matrix_t;
+#define STORAGE_NAME "bf16"
+#else
+typedef double matrix_t;
+#define STORAGE_NAME "double"
+#endif
+
+/**
+ * @brief Converts a matrix element to double.
+ */
+static inline double MatrixLoad(matrix_t value) {
+#if defined(USE_BF16)
+    return bf16_to_float(value);
+#else
+    return value;
+#endif
+}
+
+/**
+ * @brief Rounds a double to the matrix storage type.
+ */
+static inline matrix_t MatrixStore(double value) {
+#if defined(USE_BF16)
+    return bf16_from_float((float)value);
+#else
+    return (matrix_t)value;
+#endif
+}
+
+/* Matrix bytes per streamed panel when the matrix is mapped from a file. */
+#define PANEL_BYTES (16u << 20)
+
+/* Rows processed together: each loaded b[j] is reused ROW_BLOCK times. */
+#define ROW_BLOCK 4
+
+/* Vectors per register block of the batched product; rows of B and C are
+   padded to a multiple of VEC_BLOCK. */
+#define VEC_BLOCK 8
+
+/* Bytes of B kept in cache per column tile of the batched product. */
+#define BATCH_TILE_BYTES (128 * 1024)
+
 /**
  * @brief Displays an error message in Stderr.
  * @param message Error message.
@@ -24,21 +89,30 @@ void fatal(char *message) {
 }
 
 /**
- * @brief calls malloc and makes an error if the value is null,
- * and returns the result only if the value is excellent from zero.
+ * @brief Takes size bytes from the arena and makes an error if it is full. Blocks start on
+ *        a page boundary (so on a cache line: full-width vector loads of aligned rows never
+ *        split a line).
  * @param size Size isolated memory.
  */
-void *xmalloc(size_t size) {
-    register void *value = malloc(size);
-    if (value == 0) fatal("Virtuel memory exhausted");
+void *xalloc(Arena *arena, size_t size) {
+    void *value = arena_alloc(arena, size, 4096);
+    if (value == 0) fatal("Arena exhausted");
     return value;
 }
 
- 
+/**
+ * @brief Reserves an arena of size bytes (plus page alignment of up to 3 blocks) and reports it.
+ */
+void CreateArena(Arena *arena, size_t size, ArenaPages pages) {
+    if (arena_init(arena, size + 3 * 4096, pages) != 0) exit(13);
+    printf("Buffers: %s pages\n", arena_pages_name(arena->pages));
+}
+
+
 /**
  * @brief Returns the current time in seconds.
  *        Time is measured using a system call.
- * @return Current time in seconds, including fractional part 
+ * @return Current time in seconds, including fractional part
  *        with nanosecond precision.
  */
 double cpuSecond()
@@ -49,58 +123,517 @@ double cpuSecond()
 }
 
 /**
- * @briefCompute matrix-vector product vecRes[MATRIX_SIZE] = matrix[MATRIX_SIZE][MATRIX_SIZE] * vec[MATRIX_SIZE].
- * @warning the matrix must be represented in linear form.
+ * @brief Rows [lb, ub) of an m-row matrix processed by thread tid of nthreads.
+ *        The last thread also takes the remainder m % nthreads.
+ */
+void ThreadRows(int tid, int nthreads, size_t m, size_t *lb, size_t *ub) {
+    size_t items_per_thread = m / nthreads;
+    *lb = tid * items_per_thread;
+    *ub = (tid == nthreads - 1) ? m : *lb + items_per_thread;
+}
+
+/*
+ * Kernels compute c[i] = sum_j a[i * n + j] * b[j] for rows [lb, ub).
+ * Rows go in blocks of ROW_BLOCK with two vector accumulators per row:
+ * b[j] is loaded once per block, and the eight independent FMA chains
+ * hide the FMA latency. What is left of the rows and columns is done
+ * by the scalar code.
  */
-void MatrixVectorProductOmp(double *a, double *b, double *c, int m, int n) {
+typedef void (*MatVecKernel)(const matrix_t *a, const double *b, double *c, size_t lb, size_t ub, size_t n);
+
+/**
+ * @brief Dot product of a row with b, starting at column j0.
+ */
+static double RowTail(const matrix_t *row, const double *b, size_t j0, size_t n) {
+    double s = 0.0;
+    for (size_t j = j0; j < n; j++)
+        s += MatrixLoad(row[j]) * b[j];
+    return s;
+}
+
+static void MatVecScalar(const matrix_t *a, const double *b, double *c, size_t lb, size_t ub, size_t n) {
+    size_t i = lb;
+    for (; i + ROW_BLOCK <= ub; i += ROW_BLOCK) {
+        const matrix_t *r0 = a + i * n, *r1 = r0 + n, *r2 = r1 + n, *r3 = r2 + n;
+        double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+        for (size_t j = 0; j < n; j++) {
+            double bj = b[j];
+            s0 += MatrixLoad(r0[j]) * bj;
+            s1 += MatrixLoad(r1[j]) * bj;
+            s2 += MatrixLoad(r2[j]) * bj;
+            s3 += MatrixLoad(r3[j]) * bj;
+        }
+        c[i] = s0;
+        c[i + 1] = s1;
+        c[i + 2] = s2;
+        c[i + 3] = s3;
+    }
+    for (; i < ub; i++)
+        c[i] = RowTail(a + i * n, b, 0, n);
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * LoadN widens N consecutive matrix elements to doubles. bf16 becomes float
+ * by interleaving zero low halves (_mm_unpacklo_epi16 with zero), which
+ * needs nothing beyond SSE2.
+ */
+__attribute__((target("sse2")))
+static __m128d Load2Sse2(const matrix_t *p) {
+#if defined(USE_FLOAT)
+    return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)p)));
+#elif defined(USE_BF16)
+    uint32_t bits;
+    memcpy(&bits, p, sizeof(bits));
+    __m128i h = _mm_cvtsi32_si128((int)bits);
+    return _mm_cvtps_pd(_mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), h)));
+#else
+    return _mm_loadu_pd(p);
+#endif
+}
+
+__attribute__((target("sse2")))
+static double HsumSse2(__m128d v) {
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+__attribute__((target("sse2")))
+static void MatVecSse2(const matrix_t *a, const double *b, double *c, size_t lb, size_t ub, size_t n) {
+    size_t i = lb;
+    for (; i + ROW_BLOCK <= ub; i += ROW_BLOCK) {
+        const matrix_t *r0 = a + i * n, *r1 = r0 + n, *r2 = r1 + n, *r3 = r2 + n;
+        __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd(), s2 = _mm_setzero_pd(), s3 = _mm_setzero_pd();
+        __m128d t0 = _mm_setzero_pd(), t1 = _mm_setzero_pd(), t2 = _mm_setzero_pd(), t3 = _mm_setzero_pd();
+        size_t j = 0;
+        for (; j + 4 <= n; j += 4) {
+            __m128d b0 = _mm_loadu_pd(b + j), b1 = _mm_loadu_pd(b + j + 2);
+            s0 = _mm_add_pd(s0, _mm_mul_pd(Load2Sse2(r0 + j), b0));
+            t0 = _mm_add_pd(t0, _mm_mul_pd(Load2Sse2(r0 + j + 2), b1));
+            s1 = _mm_add_pd(s1, _mm_mul_pd(Load2Sse2(r1 + j), b0));
+            t1 = _mm_add_pd(t1, _mm_mul_pd(Load2Sse2(r1 + j + 2), b1));
+            s2 = _mm_add_pd(s2, _mm_mul_pd(Load2Sse2(r2 + j), b0));
+            t2 = _mm_add_pd(t2, _mm_mul_pd(Load2Sse2(r2 + j + 2), b1));
+            s3 = _mm_add_pd(s3, _mm_mul_pd(Load2Sse2(r3 + j), b0));
+            t3 = _mm_add_pd(t3, _mm_mul_pd(Load2Sse2(r3 + j + 2), b1));
+        }
+        c[i] = HsumSse2(_mm_add_pd(s0, t0)) + RowTail(r0, b, j, n);
+        c[i + 1] = HsumSse2(_mm_add_pd(s1, t1)) + RowTail(r1, b, j, n);
+        c[i + 2] = HsumSse2(_mm_add_pd(s2, t2)) + RowTail(r2, b, j, n);
+        c[i + 3] = HsumSse2(_mm_add_pd(s3, t3)) + RowTail(r3, b, j, n);
+    }
+    for (; i < ub; i++)
+        c[i] = RowTail(a + i * n, b, 0, n);
+}
+
+__attribute__((target("avx2,fma")))
+static __m256d Load4Avx2(const matrix_t *p) {
+#if defined(USE_FLOAT)
+    return _mm256_cvtps_pd(_mm_loadu_ps(p));
+#elif defined(USE_BF16)
+    __m128i h = _mm_loadl_epi64((const __m128i *)p);
+    return _mm256_cvtps_pd(_mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), h)));
+#else
+    return _mm256_loadu_pd(p);
+#endif
+}
+
+__attribute__((target("avx2,fma")))
+static double HsumAvx2(__m256d v) {
+    __m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2,fma")))
+static void MatVecAvx2(const matrix_t *a, const double *b, double *c, size_t lb, size_t ub, size_t n) {
+    size_t i = lb;
+    for (; i + ROW_BLOCK <= ub; i += ROW_BLOCK) {
+        const matrix_t *r0 = a + i * n, *r1 = r0 + n, *r2 = r1 + n, *r3 = r2 + n;
+        __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+        __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+        __m256d t0 = _mm256_setzero_pd(), t1 = _mm256_setzero_pd();
+        __m256d t2 = _mm256_setzero_pd(), t3 = _mm256_setzero_pd();
+        size_t j = 0;
+        for (; j + 8 <= n; j += 8) {
+            __m256d b0 = _mm256_loadu_pd(b + j), b1 = _mm256_loadu_pd(b + j + 4);
+            s0 = _mm256_fmadd_pd(Load4Avx2(r0 + j), b0, s0);
+            t0 = _mm256_fmadd_pd(Load4Avx2(r0 + j + 4), b1, t0);
+            s1 = _mm256_fmadd_pd(Load4Avx2(r1 + j), b0, s1);
+            t1 = _mm256_fmadd_pd(Load4Avx2(r1 + j + 4), b1, t1);
+            s2 = _mm256_fmadd_pd(Load4Avx2(r2 + j), b0, s2);
+            t2 = _mm256_fmadd_pd(Load4Avx2(r2 + j + 4), b1, t2);
+            s3 = _mm256_fmadd_pd(Load4Avx2(r3 + j), b0, s3);
+            t3 = _mm256_fmadd_pd(Load4Avx2(r3 + j + 4), b1, t3);
+        }
+        c[i] = HsumAvx2(_mm256_add_pd(s0, t0)) + RowTail(r0, b, j, n);
+        c[i + 1] = HsumAvx2(_mm256_add_pd(s1, t1)) + RowTail(r1, b, j, n);
+        c[i + 2] = HsumAvx2(_mm256_add_pd(s2, t2)) + RowTail(r2, b, j, n);
+        c[i + 3] = HsumAvx2(_mm256_add_pd(s3, t3)) + RowTail(r3, b, j, n);
+    }
+    for (; i < ub; i++)
+        c[i] = RowTail(a + i * n, b, 0, n);
+}
+
+__attribute__((target("avx512f")))
+static __m512d Load8Avx512(const matrix_t *p) {
+#if defined(USE_FLOAT)
+    return _mm512_cvtps_pd(_mm256_loadu_ps(p));
+#elif defined(USE_BF16)
+    __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p));
+    return _mm512_cvtps_pd(_mm256_castsi256_ps(_mm256_slli_epi32(h, 16)));
+#else
+    return _mm512_loadu_pd(p);
+#endif
+}
+
+__attribute__((target("avx512f")))
+static void MatVecAvx512(const matrix_t *a, const double *b, double *c, size_t lb, size_t ub, size_t n) {
+    size_t i = lb;
+    for (; i + ROW_BLOCK <= ub; i += ROW_BLOCK) {
+        const matrix_t *r0 = a + i * n, *r1 = r0 + n, *r2 = r1 + n, *r3 = r2 + n;
+        __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+        __m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+        __m512d t0 = _mm512_setzero_pd(), t1 = _mm512_setzero_pd();
+        __m512d t2 = _mm512_setzero_pd(), t3 = _mm512_setzero_pd();
+        size_t j = 0;
+        for (; j + 16 <= n; j += 16) {
+            __m512d b0 = _mm512_loadu_pd(b + j), b1 = _mm512_loadu_pd(b + j + 8);
+            s0 = _mm512_fmadd_pd(Load8Avx512(r0 + j), b0, s0);
+            t0 = _mm512_fmadd_pd(Load8Avx512(r0 + j + 8), b1, t0);
+            s1 = _mm512_fmadd_pd(Load8Avx512(r1 + j), b0, s1);
+            t1 = _mm512_fmadd_pd(Load8Avx512(r1 + j + 8), b1, t1);
+            s2 = _mm512_fmadd_pd(Load8Avx512(r2 + j), b0, s2);
+            t2 = _mm512_fmadd_pd(Load8Avx512(r2 + j + 8), b1, t2);
+            s3 = _mm512_fmadd_pd(Load8Avx512(r3 + j), b0, s3);
+            t3 = _mm512_fmadd_pd(Load8Avx512(r3 + j + 8), b1, t3);
+        }
+        c[i] = _mm512_reduce_add_pd(_mm512_add_pd(s0, t0)) + RowTail(r0, b, j, n);
+        c[i + 1] = _mm512_reduce_add_pd(_mm512_add_pd(s1, t1)) + RowTail(r1, b, j, n);
+        c[i + 2] = _mm512_reduce_add_pd(_mm512_add_pd(s2, t2)) + RowTail(r2, b, j, n);
+        c[i + 3] = _mm512_reduce_add_pd(_mm512_add_pd(s3, t3)) + RowTail(r3, b, j, n);
+    }
+    for (; i < ub; i++)
+        c[i] = RowTail(a + i * n, b, 0, n);
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+/* Kernels from the widest ISA to the narrowest; "scalar" is always available. */
+static const char *kernel_names[] = {"avx512", "avx2", "sse2", "scalar"};
+static const MatVecKernel kernels[] = {
+#ifdef HAVE_X86_KERNELS
+    MatVecAvx512, MatVecAvx2, MatVecSse2,
+#else
+    0, 0, 0,
+#endif
+    MatVecScalar};
+#define NKERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+/**
+ * @brief Checks with CPUID whether kernel k can run on this processor.
+ */
+static int KernelSupported(size_t k) {
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    switch (k) {
+        case 0: return __builtin_cpu_supports("avx512f");
+        case 1: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case 2: return __builtin_cpu_supports("sse2");
+        default: return 1;
+    }
+#else
+    return kernels[k] != 0;
+#endif
+}
+
+/**
+ * @brief Selects the kernel by name, or the widest supported one for "auto".
+ * @return Kernel index, or -1 if the name is unknown or not supported by the CPU.
+ */
+static int SelectKernel(const char *name) {
+    for (size_t k = 0; k < NKERNELS; k++) {
+        int match = strcmp(name, "auto") == 0 || strcmp(name, kernel_names[k]) == 0;
+        if (match && KernelSupported(k)) return (int)k;
+        if (match && strcmp(name, "auto") != 0) return -1;
+    }
+    return -1;
+}
+
+/**
+ * @brief Rows of a thread's range [lb, ub) are processed in panels. For a matrix mapped from
+ *        a file (mf != NULL) the panel after the current one is handed to readahead, so reading
+ *        it from disk overlaps with computing the current one; otherwise the whole range is one panel.
+ * @return End of the panel that starts at r0.
+ */
+static size_t NextPanel(const MatrixFile *mf, size_t r0, size_t ub) {
+    if (!mf) return ub;
+    size_t panel_rows = matrix_file_panel_rows(mf, PANEL_BYTES, ROW_BLOCK);
+    size_t r1 = (r0 + panel_rows < ub) ? r0 + panel_rows : ub;
+    matrix_file_advise(mf, r1, (r1 + panel_rows < ub) ? r1 + panel_rows : ub, MADV_WILLNEED);
+    return r1;
+}
+
+/**
+ * @brief Compute matrix-vector product c[m] = a[m][n] * b[n] with the given kernel.
+ * @param mf File the matrix is mapped from, or NULL for a matrix in memory.
+ * @warning the matrix must be represented in linear form, row i starts at a[i * n].
+ */
+void MatrixVectorProductOmp(const matrix_t *a, double *b, double *c, int m, int n, MatVecKernel kernel,
+                            const MatrixFile *mf) {
 #pragma omp parallel num_threads(NTHREADS)
     {
-        int tid = omp_get_thread_num();
-        // number of vector elements counted by one thread
-        int items_per_thread = m / NTHREADS; 
-        /* The parallel part of the code will find the elements of the vector 
-            in the range [LB, UB].
+        /* The parallel part of the code will find the elements of the vector
+            in the range [LB, UB).
             LB - Lower_Bound
-            UB - pper_bound
+            UB - Upper_bound
         */
-        int lb = tid * items_per_thread;
-        int ub = (tid == NTHREADS) ? (m - 1) : (lb + items_per_thread - 1);
-
-        for (int i = lb; i <= ub; i++) {
-            c[i] = 0;
-            for (int j = 0; j < n; j++) {
-                c[i] += a[i * m + j] * b[j];
-            }
+        size_t lb, ub;
+        ThreadRows(omp_get_thread_num(), omp_get_num_threads(), m, &lb, &ub);
+        if (mf) matrix_file_advise(mf, lb, NextPanel(mf, lb, ub), MADV_WILLNEED);
+        for (size_t r0 = lb, r1; r0 < ub; r0 = r1) {
+            r1 = NextPanel(mf, r0, ub);
+            kernel(a, b, c, r0, r1, n);
         }
     }
 }
 
+/*
+ * Batched product C[m][k] = a[m][n] * B[n][k]: the same matrix applied to k
+ * vectors in one pass. B and C are stored vector-interleaved, element v of
+ * row j at B[j * ldk + v], with ldk = k rounded up to VEC_BLOCK (the padding
+ * is zero). Columns go in tiles of BatchColumnTile(ldk) so the B tile stays
+ * in L2 while the thread walks its rows; for a block of ROW_BLOCK rows and
+ * VEC_BLOCK vectors the sums live in registers, and every matrix element
+ * fetched from memory is used for all k vectors.
+ */
+
+/**
+ * @brief Padded row length of B and C for k vectors.
+ */
+size_t BatchStride(int k) {
+    return ((size_t)k + VEC_BLOCK - 1) / VEC_BLOCK * VEC_BLOCK;
+}
+
 /**
- * @brief calculates the time spent on the parallel multiplication of the matrix 
+ * @brief Column tile of the batched product: B tile of about BATCH_TILE_BYTES, multiple of 16.
+ */
+static size_t BatchColumnTile(size_t ldk) {
+    size_t jt = BATCH_TILE_BYTES / (ldk * sizeof(double)) / 16 * 16;
+    return jt < 64 ? 64 : jt;
+}
+
+/**
+ * @brief Adds a[rows][j0:j1] * B[j0:j1][v0:v0 + VEC_BLOCK] to C for nrows <= ROW_BLOCK rows.
+ */
+typedef void (*BatchBlockFn)(const matrix_t *const *rows, size_t nrows, const double *B, double *C, size_t j0,
+                             size_t j1, size_t v0, size_t ldk);
+
+/*
+ * Defines a BatchBlockFn whose ROW_BLOCK x VEC_BLOCK sums are held in GCC vectors of
+ * type VEC_T, the native register width of the target: with a constant trip count the
+ * acc array is fully unrolled into registers (the baseline's 16 xmm partly spill).
+ * B and C rows are 64-byte aligned, so the vector loads are aligned.
+ */
+#define DEFINE_BATCH_BLOCK(NAME, ATTR, VEC_T)                                                                   \
+    ATTR static void NAME(const matrix_t *const *rows, size_t nrows, const double *B, double *C, size_t j0,     \
+                          size_t j1, size_t v0, size_t ldk) {                                                   \
+        enum { NV = VEC_BLOCK * sizeof(double) / sizeof(VEC_T) };                                               \
+        if (nrows == ROW_BLOCK) {                                                                               \
+            VEC_T acc[ROW_BLOCK][NV];                                                                           \
+            for (size_t r = 0; r < ROW_BLOCK; r++)                                                              \
+                for (size_t v = 0; v < NV; v++)                                                                 \
+                    acc[r][v] = ((const VEC_T *)(C + r * ldk + v0))[v];                                         \
+            for (size_t j = j0; j < j1; j++) {                                                                  \
+                const VEC_T *bj = (const VEC_T *)(B + j * ldk + v0);                                            \
+                for (size_t r = 0; r < ROW_BLOCK; r++) {                                                        \
+                    double x = MatrixLoad(rows[r][j]);                                                          \
+                    for (size_t v = 0; v < NV; v++)                                                             \
+                        acc[r][v] += x * bj[v];                                                                 \
+                }                                                                                               \
+            }                                                                                                   \
+            for (size_t r = 0; r < ROW_BLOCK; r++)                                                              \
+                for (size_t v = 0; v < NV; v++)                                                                 \
+                    ((VEC_T *)(C + r * ldk + v0))[v] = acc[r][v];                                               \
+            return;                                                                                             \
+        }                                                                                                       \
+        for (size_t r = 0; r < nrows; r++) {                                                                    \
+            VEC_T acc[NV];                                                                                      \
+            for (size_t v = 0; v < NV; v++)                                                                     \
+                acc[v] = ((const VEC_T *)(C + r * ldk + v0))[v];                                                \
+            for (size_t j = j0; j < j1; j++) {                                                                  \
+                const VEC_T *bj = (const VEC_T *)(B + j * ldk + v0);                                            \
+                double x = MatrixLoad(rows[r][j]);                                                              \
+                for (size_t v = 0; v < NV; v++)                                                                 \
+                    acc[v] += x * bj[v];                                                                        \
+            }                                                                                                   \
+            for (size_t v = 0; v < NV; v++)                                                                     \
+                ((VEC_T *)(C + r * ldk + v0))[v] = acc[v];                                                      \
+        }                                                                                                       \
+    }
+
+typedef double vec2d_t __attribute__((vector_size(2 * sizeof(double))));
+DEFINE_BATCH_BLOCK(BatchBlockBaseline, , vec2d_t)
+
+#ifdef HAVE_X86_KERNELS
+typedef double vec4d_t __attribute__((vector_size(4 * sizeof(double))));
+typedef double vec8d_t __attribute__((vector_size(8 * sizeof(double))));
+DEFINE_BATCH_BLOCK(BatchBlockAvx2, __attribute__((target("avx2,fma"))), vec4d_t)
+DEFINE_BATCH_BLOCK(BatchBlockAvx512, __attribute__((target("avx512f"))), vec8d_t)
+#endif
+
+/**
+ * @brief Batched product for rows [lb, ub) with the given register-block routine.
+ */
+static void MatMultiVecRows(const matrix_t *a, const double *B, double *C, size_t lb, size_t ub, size_t n,
+                            size_t ldk, BatchBlockFn block) {
+    const size_t jt = BatchColumnTile(ldk);
+    memset(C + lb * ldk, 0, (ub - lb) * ldk * sizeof(double));
+
+    for (size_t j0 = 0; j0 < n; j0 += jt) {
+        size_t j1 = (j0 + jt < n) ? j0 + jt : n;
+        for (size_t i = lb; i < ub; i += ROW_BLOCK) {
+            size_t nrows = (ub - i < ROW_BLOCK) ? ub - i : ROW_BLOCK;
+            const matrix_t *rows[ROW_BLOCK];
+            for (size_t r = 0; r < nrows; r++)
+                rows[r] = a + (i + r) * n;
+            for (size_t v0 = 0; v0 < ldk; v0 += VEC_BLOCK)
+                block(rows, nrows, B, C + i * ldk, j0, j1, v0, ldk);
+        }
+    }
+}
+
+/* Register-block routines in the order of kernel_names; sse2 and scalar share the baseline build. */
+static const BatchBlockFn batch_blocks[] = {
+#ifdef HAVE_X86_KERNELS
+    BatchBlockAvx512, BatchBlockAvx2,
+#else
+    0, 0,
+#endif
+    BatchBlockBaseline, BatchBlockBaseline};
+
+/**
+ * @brief Compute C[m][k] = a[m][n] * B[n][k] for k vectors stored with stride BatchStride(k).
+ */
+void MatrixMultiVectorProductOmp(const matrix_t *a, double *B, double *C, int m, int n, int k, BatchBlockFn block,
+                                 const MatrixFile *mf) {
+#pragma omp parallel num_threads(NTHREADS)
+    {
+        size_t lb, ub;
+        ThreadRows(omp_get_thread_num(), omp_get_num_threads(), m, &lb, &ub);
+        if (mf) matrix_file_advise(mf, lb, NextPanel(mf, lb, ub), MADV_WILLNEED);
+        for (size_t r0 = lb, r1; r0 < ub; r0 = r1) {
+            r1 = NextPanel(mf, r0, ub);
+            MatMultiVecRows(a, B, C, r0, r1, n, BatchStride(k), block);
+        }
+    }
+}
+
+/**
+ * @brief Fills rows [r0, r1) of the test matrix, a[i][j] = i + j; rows points to row r0.
+ */
+static void FillMatrixRows(void *rows, size_t r0, size_t r1, size_t cols) {
+    matrix_t *a = rows;
+    for (size_t i = r0; i < r1; i++)
+        for (size_t j = 0; j < cols; j++)
+            a[(i - r0) * cols + j] = MatrixStore(i + j);
+}
+
+/**
+ * @brief Test matrix a[i][j] = i + j: mapped from the file at path (written on the first run,
+ *        reused afterwards) or, for path == NULL, taken from the arena and filled with the
+ *        same row partition as the product (first touch).
+ * @return The matrix, or NULL if the file could not be opened.
+ */
+matrix_t *CreateMatrix(int m, int n, const char *path, MatrixFile *mf, Arena *arena) {
+    memset(mf, 0, sizeof(*mf));
+    if (path) {
+        double start = cpuSecond();
+        if (matrix_file_open(mf, path, m, n, sizeof(matrix_t), STORAGE_NAME, FillMatrixRows) != 0) return NULL;
+        printf("Matrix file %s: %s in %.4lf seconds\n", path, mf->created ? "written" : "reused",
+               cpuSecond() - start);
+        return mf->data;
+    }
+
+    matrix_t *a = xalloc(arena, sizeof(*a) * m * n);
+    #pragma omp parallel num_threads(NTHREADS)
+    {
+        size_t lb, ub;
+        ThreadRows(omp_get_thread_num(), omp_get_num_threads(), m, &lb, &ub);
+        FillMatrixRows(a + lb * n, lb, ub, n);
+    }
+    return a;
+}
+
+/**
+ * @brief Bytes the matrix takes from the arena: none if it is mapped from a file.
+ */
+size_t MatrixArenaBytes(int m, int n, const char *path) {
+    return path ? 0 : sizeof(matrix_t) * (size_t)m * n;
+}
+
+/**
+ * @brief Max relative deviation of c from the exact product for a[i][j] = i + j, b[j] = j:
+ *        c[i] = i * S1 + S2, S1 = sum j, S2 = sum j^2 (exact in double up to n ~ 2^17).
+ */
+double MaxRelativeError(const double *c, int m, int n) {
+    double s1 = (double)n * (n - 1) / 2;
+    double s2 = (double)n * (n - 1) * (2.0 * n - 1) / 6;
+    double max_err = 0.0;
+    for (int i = 0; i < m; i++) {
+        double exact = i * s1 + s2;
+        double err = (exact != 0.0) ? fabs(c[i] - exact) / exact : fabs(c[i]);
+        if (err > max_err) max_err = err;
+    }
+    return max_err;
+}
+
+/**
+ * @brief Max relative deviation of the batched result from the exact product for
+ *        a[i][j] = i + j, B[j][v] = j + v: C[i][v] = i * S1 + S2 + v * (i * n + S1).
+ */
+double MaxRelativeErrorBatch(const double *C, int m, int n, int k) {
+    size_t ldk = BatchStride(k);
+    double s1 = (double)n * (n - 1) / 2;
+    double s2 = (double)n * (n - 1) * (2.0 * n - 1) / 6;
+    double max_err = 0.0;
+    for (int i = 0; i < m; i++) {
+        for (int v = 0; v < k; v++) {
+            double exact = i * s1 + s2 + v * ((double)i * n + s1);
+            double got = C[i * ldk + v];
+            double err = (exact != 0.0) ? fabs(got - exact) / exact : fabs(got);
+            if (err > max_err) max_err = err;
+        }
+    }
+    return max_err;
+}
+
+/**
+ * @brief calculates the time spent on the parallel multiplication of the matrix
  *        by the vector.
  * @return returns the minimum time (20 launches) spent on executing the parallel part.
  */
-void TimeCheckParallel() {
-    double *a, *b, *c;
+void TimeCheckParallel(int m, int n, MatVecKernel kernel, const char *path, ArenaPages pages) {
+    MatrixFile mf;
+    Arena arena;
+    matrix_t *a;
+    double *b, *c;
 
-    a = xmalloc(sizeof(*a) * MATRIX_SIZE * MATRIX_SIZE);
-    b = xmalloc(sizeof(*b) * MATRIX_SIZE);
-    c = xmalloc(sizeof(*c) * MATRIX_SIZE);
+    CreateArena(&arena, MatrixArenaBytes(m, n, path) + sizeof(*b) * n + sizeof(*c) * m, pages);
+    a = CreateMatrix(m, n, path, &mf, &arena);
+    if (!a) {
+        arena_release(&arena);
+        return;
+    }
+    b = xalloc(&arena, sizeof(*b) * n);
+    c = xalloc(&arena, sizeof(*c) * m);
 
     #pragma omp parallel num_threads(NTHREADS)
     {
-        int nthreads = omp_get_num_threads();
-        int threadid = omp_get_thread_num();
-        int items_per_thread = MATRIX_SIZE / nthreads;
-        int lb = threadid * items_per_thread;
-        int ub = (threadid == nthreads - 1) ? (MATRIX_SIZE - 1) : (lb + items_per_thread - 1);
-        for (int i = lb; i <= ub; i++) {
-            for (int j = 0; j < MATRIX_SIZE; j++)
-                a[i * MATRIX_SIZE + j] = i + j;
-            c[i] = 0.0;
-        }
+        size_t lb, ub;
+        ThreadRows(omp_get_thread_num(), omp_get_num_threads(), m, &lb, &ub);
+        memset(c + lb, 0, (ub - lb) * sizeof(double));
     }
-    for (int j = 0; j < MATRIX_SIZE; j++)
+    for (int j = 0; j < n; j++)
         b[j] = j;
 
     double min_time = 1000000000;
@@ -109,28 +642,132 @@ void TimeCheckParallel() {
 
         double start = cpuSecond();
 
-        MatrixVectorProductOmp(a, b, c, MATRIX_SIZE, MATRIX_SIZE);
-        
+        MatrixVectorProductOmp(a, b, c, m, n, kernel, mf.map ? &mf : NULL);
+
         double stop = cpuSecond();
 
         min_time = (min_time < (stop - start)) ? min_time : stop - start;
     }
-    
+
+    double bytes = (double)m * n * sizeof(matrix_t) + (double)(m + n) * sizeof(double);
     printf("Your calculations took %.4lf seconds.\n", min_time);
+    printf("Effective bandwidth: %.2lf GB/s\n", bytes / min_time * 1.e-9);
+    printf("Max relative error vs exact result: %.3e\n", MaxRelativeError(c, m, n));
 
 
-    free(a);
-    free(b);
-    free(c);
-    
+    matrix_file_close(&mf);
+    arena_release(&arena);
 }
 
-int main() {
+/**
+ * @brief calculates the time spent on the parallel multiplication of the matrix
+ *        by a block of k vectors and reports the throughput per vector.
+ */
+void TimeCheckParallelBatch(int m, int n, int k, BatchBlockFn block, const char *path, ArenaPages pages) {
+    size_t ldk = BatchStride(k);
+    MatrixFile mf;
+    Arena arena;
+    matrix_t *a;
+    double *B, *C;
+
+    CreateArena(&arena, MatrixArenaBytes(m, n, path) + sizeof(*B) * ((size_t)m + n) * ldk, pages);
+    a = CreateMatrix(m, n, path, &mf, &arena);
+    if (!a) {
+        arena_release(&arena);
+        return;
+    }
+    B = xalloc(&arena, sizeof(*B) * n * ldk);
+    C = xalloc(&arena, sizeof(*C) * m * ldk);
+
+    #pragma omp parallel num_threads(NTHREADS)
+    {
+        size_t lb, ub;
+        ThreadRows(omp_get_thread_num(), omp_get_num_threads(), m, &lb, &ub);
+        memset(C + lb * ldk, 0, (ub - lb) * ldk * sizeof(double));
+    }
+    for (size_t j = 0; j < (size_t)n; j++)
+        for (size_t v = 0; v < ldk; v++)
+            B[j * ldk + v] = (v < (size_t)k) ? (double)(j + v) : 0.0;
+
+    double min_time = 1000000000;
+
+    for (int i = 0; i<20; i++){
+
+        double start = cpuSecond();
+
+        MatrixMultiVectorProductOmp(a, B, C, m, n, k, block, mf.map ? &mf : NULL);
+
+        double stop = cpuSecond();
+
+        min_time = (min_time < (stop - start)) ? min_time : stop - start;
+    }
+
+    printf("Your calculations took %.4lf seconds (%d vectors).\n", min_time, k);
+    printf("Time per vector: %.6lf seconds\n", min_time / k);
+    printf("Throughput: %.2lf GFLOP/s\n", 2.0 * m * n * k / min_time * 1.e-9);
+    printf("Max relative error vs exact result: %.3e\n", MaxRelativeErrorBatch(C, m, n, k));
+
+    matrix_file_close(&mf);
+    arena_release(&arena);
+}
+
+int main(int argc, char **argv) {
     int m = MATRIX_SIZE;
-    int n = MATRIX_SIZE;
-    printf("Matrix-vector product (c[m] = a[m, n] * b[n]; m = %d, n = %d)\n", m, n);
-    printf("Memory used: %" PRIu64 " MiB\n", ((m * n + m + n) * sizeof(double)) >> 20);
+    int n = MATRIX_COLS;
+    const char *isa = "auto";
+    int vectors = 1;
+    const char *path = NULL;
+    ArenaPages pages = ARENA_PAGES_TRANSPARENT;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "k:v:f:p:")) != -1) {
+        switch (opt) {
+            case 'k':
+                isa = optarg;
+                break;
+            case 'v':
+                vectors = atoi(optarg);
+                break;
+            case 'f':
+                path = optarg;
+                break;
+            case 'p':
+                if (arena_pages_from_name(optarg, &pages) == 0) break;
+                /* fall through */
+            default:
+                fprintf(stderr,
+                        "Usage: %s [-k auto|avx512|avx2|sse2|scalar] [-v vectors] [-f matrix_file]"
+                        " [-p default|thp|hugetlb]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (vectors < 1) {
+        fprintf(stderr, "Number of vectors must be positive\n");
+        return 1;
+    }
+
+    int k = SelectKernel(isa);
+    if (k < 0) {
+        fprintf(stderr, "Kernel '%s' is unknown or not supported by this CPU\n", isa);
+        return 1;
+    }
+
+    if (vectors > 1) {
+        printf("Matrix-multivector product (C[m, k] = a[m, n] * B[n, k]; m = %d, n = %d, k = %d)\n", m, n, vectors);
+        printf("Memory used: %" PRIu64 " MiB\n",
+               ((uint64_t)m * n * sizeof(matrix_t) + ((uint64_t)m + n) * BatchStride(vectors) * sizeof(double)) >> 20);
+    } else {
+        printf("Matrix-vector product (c[m] = a[m, n] * b[n]; m = %d, n = %d)\n", m, n);
+        printf("Memory used: %" PRIu64 " MiB\n",
+               ((uint64_t)m * n * sizeof(matrix_t) + ((uint64_t)m + n) * sizeof(double)) >> 20);
+    }
+    printf("Matrix storage: %s\n", STORAGE_NAME);
     printf("Number of threads: %d\n", NTHREADS);
-    
-    TimeCheckParallel();
-}
\ No newline at end of file
+
+    printf("Kernel: %s\n", kernel_names[k]);
+    if (vectors > 1)
+        TimeCheckParallelBatch(m, n, vectors, batch_blocks[k], path, pages);
+    else
+        TimeCheckParallel(m, n, kernels[k], path, pages);
+}
@@ -4,6 +4,9 @@
 #include <omp.h>
 #include <time.h>
 #include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include "simd_math.h"
 
 #ifdef NTHREADS
 #else
@@ -12,6 +15,34 @@
 
 const int nsteps = 40000000;
 
+/* Points evaluated per call of a batch integrand; the buffers stay in L1. */
+#define BATCH_SIZE 1024
+
+/**
+ * @brief Integrand evaluated on a batch of points: y[i] = f(x[i]), i < n.
+ */
+typedef void (*BatchFunction)(const double *x, double *y, int n);
+
+/* Integration modes selected with -m. */
+enum { MODE_LIBM, MODE_SIMD, MODE_ADAPTIVE };
+
+/* Subintervals shorter than this many halvings of [a, b] are accepted as they are. */
+#define ADAPTIVE_MAX_DEPTH 40
+
+/* Below this depth each half of a split interval becomes an OpenMP task; deeper
+   subdivision runs inside the task that reached it. */
+#define ADAPTIVE_TASK_DEPTH 16
+
+/**
+ * @brief Result of the adaptive integration: the integral, the estimate of its
+ *        absolute error and the number of integrand evaluations.
+ */
+typedef struct {
+    double result;
+    double error;
+    long evals;
+} QuadResult;
+
 /**
  * @brief Returns the current time in seconds.
  *        Time is measured using a system call.
@@ -32,6 +63,13 @@ double f(double x){
     return sin(x);
 }
 
+/**
+ * @brief f on a batch of points with the vectorized sine from simd_math.h.
+ */
+void f_batch(const double *x, double *y, int n){
+    simd_sin_array_f64(x, y, n);
+}
+
 /**
  * @brief Compute integral[a,b]f(x)dx using the parallel numerical
  *  midpoint rectangle method.
@@ -46,7 +84,7 @@ double ParallelIntegral(double a, double b, double(*f)(double)){
         int threadid = omp_get_thread_num();
         int items_per_thread = nsteps / NTHREADS;
         int lb = threadid * items_per_thread;
-        int ub = (threadid == NTHREADS) ? (nsteps - 1) : (lb + items_per_thread - 1);
+        int ub = (threadid == NTHREADS - 1) ? (nsteps - 1) : (lb + items_per_thread - 1);
 
         double sum_per_thread = 0.0;
 
@@ -61,6 +99,142 @@ double ParallelIntegral(double a, double b, double(*f)(double)){
     return sum;
 }
 
+/**
+ * @brief Same midpoint rule as ParallelIntegral, but the integrand is evaluated
+ *  BATCH_SIZE points per call, so a vectorized f pays the call once per batch.
+ */
+double ParallelIntegralBatch(double a, double b, BatchFunction f){
+
+    double h = (b-a)/nsteps;
+    double sum = 0.0;
+
+    #pragma omp parallel num_threads(NTHREADS)
+    {
+        int threadid = omp_get_thread_num();
+        int items_per_thread = nsteps / NTHREADS;
+        int lb = threadid * items_per_thread;
+        int ub = (threadid == NTHREADS - 1) ? (nsteps - 1) : (lb + items_per_thread - 1);
+
+        double x[BATCH_SIZE], y[BATCH_SIZE];
+        double sum_per_thread = 0.0;
+
+        for (int i0 = lb; i0<=ub; i0 += BATCH_SIZE){
+            int n = (ub - i0 + 1 < BATCH_SIZE) ? ub - i0 + 1 : BATCH_SIZE;
+            for (int i = 0; i<n; i++)
+                x[i] = a + h * (i0 + i + 0.5);
+            f(x, y, n);
+            for (int i = 0; i<n; i++)
+                sum_per_thread += y[i];
+        }
+
+        #pragma omp atomic
+        sum += sum_per_thread;
+    }
+    sum *=h;
+    return sum;
+}
+
+
+/* Gauss-Kronrod 7-15 rule on [-1, 1] (QUADPACK qk15): Kronrod nodes xgk (the odd ones
+   are the Gauss nodes) and weights wgk, Gauss weights wg (the last one - centre). */
+static const double xgk[8] = {
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.000000000000000000000000000000000};
+static const double wgk[8] = {
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+static const double wg[4] = {
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+
+/**
+ * @brief Integral of f over [a, b] by the 15-point Kronrod rule; the error is
+ *        estimated from its difference to the embedded 7-point Gauss rule, scaled
+ *        as in QUADPACK, and is never below the rounding error *roundoff of the sum.
+ */
+double GaussKronrod15(double a, double b, double(*f)(double), double *error, double *roundoff){
+    double centr = 0.5 * (a + b);
+    double hlgth = 0.5 * (b - a);
+    double fv1[7], fv2[7];
+
+    double fc = f(centr);
+    double resg = fc * wg[3];
+    double resk = fc * wgk[7];
+    double resabs = fabs(resk);
+    for (int j = 0; j<7; j++){
+        double x = hlgth * xgk[j];
+        fv1[j] = f(centr - x);
+        fv2[j] = f(centr + x);
+        double fsum = fv1[j] + fv2[j];
+        resk += wgk[j] * fsum;
+        resabs += wgk[j] * (fabs(fv1[j]) + fabs(fv2[j]));
+        if (j % 2 == 1)
+            resg += wg[j / 2] * fsum;
+    }
+
+    double reskh = resk * 0.5;
+    double resasc = wgk[7] * fabs(fc - reskh);
+    for (int j = 0; j<7; j++)
+        resasc += wgk[j] * (fabs(fv1[j] - reskh) + fabs(fv2[j] - reskh));
+
+    double result = resk * hlgth;
+    resabs *= fabs(hlgth);
+    resasc *= fabs(hlgth);
+    double err = fabs((resk - resg) * hlgth);
+    if (resasc != 0.0 && err != 0.0)
+        err = resasc * fmin(1.0, pow(200.0 * err / resasc, 1.5));
+    *roundoff = 50 * 2.220446049250313e-16 * resabs;
+    *error = fmax(*roundoff, err);
+    return result;
+}
+
+/**
+ * @brief Integrates f over [a, b] and splits the interval in two while the error
+ *        estimate exceeds tol and the rounding error; each half gets half of the
+ *        tolerance. Halves of shallow
+ *        intervals are spawned as tasks, so idle threads of the team steal them.
+ *        Accepted intervals are added to *total.
+ */
+void AdaptiveSegment(double a, double b, double(*f)(double), double tol, int depth, QuadResult *total){
+    double error, roundoff;
+    double result = GaussKronrod15(a, b, f, &error, &roundoff);
+
+    if (error <= tol || error <= roundoff || depth >= ADAPTIVE_MAX_DEPTH){
+        #pragma omp atomic
+        total->result += result;
+        #pragma omp atomic
+        total->error += error;
+        #pragma omp atomic
+        total->evals += 15;
+        return;
+    }
+
+    #pragma omp atomic
+    total->evals += 15;
+
+    double mid = 0.5 * (a + b);
+    #pragma omp task if(depth < ADAPTIVE_TASK_DEPTH)
+    AdaptiveSegment(a, mid, f, 0.5 * tol, depth + 1, total);
+    AdaptiveSegment(mid, b, f, 0.5 * tol, depth + 1, total);
+}
+
+/**
+ * @brief Compute integral[a,b]f(x)dx with absolute tolerance tol by adaptive
+ *  Gauss-Kronrod quadrature; subintervals are processed as OpenMP tasks.
+ */
+QuadResult AdaptiveIntegral(double a, double b, double(*f)(double), double tol){
+    QuadResult total = {0.0, 0.0, 0};
+
+    #pragma omp parallel num_threads(NTHREADS)
+    #pragma omp single
+    AdaptiveSegment(a, b, f, tol, 0, &total);
+
+    return total;
+}
 
 /**
  * @brief "Calculates the time spent on the parallel computation of the integral 
@@ -68,17 +242,19 @@ double ParallelIntegral(double a, double b, double(*f)(double)){
  * @return returns the minimum time (20 launches) spent on executing 
  *          the parallel part .
  */
-void TimeCheckParallel() {
+void TimeCheckParallel(int use_simd) {
 
     double a = 10;
     printf("Integration f(x) on [%.12f, %.12f], nsteps = %d\n", -a, a, nsteps);
+    printf("Integrand: %s\n", use_simd ? "simd (batched)" : "libm");
+    printf("Function evaluations: %d\n", nsteps);
 
     double min_time = 1000000000;
     double result;
 
     for (int i = 0; i<20; i++){
         double start = cpuSecond();
-        result = ParallelIntegral(-a, a, f);
+        result = use_simd ? ParallelIntegralBatch(-a, a, f_batch) : ParallelIntegral(-a, a, f);
         double stop = cpuSecond();
         min_time = (min_time < (stop - start)) ? min_time : stop - start;
     }
@@ -88,7 +264,62 @@ void TimeCheckParallel() {
     
 }
 
-int main(){
+/**
+ * @brief Compares adaptive Gauss-Kronrod integration with absolute tolerance tol
+ *        against the fixed-step midpoint rule (minimum time of 20 launches each).
+ *        The interval [0, a] is not symmetric, so neither method gets the odd
+ *        integrand's zero for free: integral[0,a]sin(x)dx = 1 - cos(a).
+ */
+void TimeCheckAdaptive(double tol) {
+
+    double a = 10;
+    double exact = 1 - cos(a);
+    printf("Integration f(x) on [%.12f, %.12f], exact %.15f\n", 0.0, a, exact);
+
+    double fixed_time = 1000000000, adaptive_time = 1000000000;
+    double fixed;
+    QuadResult adaptive;
+
+    for (int i = 0; i<20; i++){
+        double start = cpuSecond();
+        fixed = ParallelIntegral(0, a, f);
+        double stop = cpuSecond();
+        fixed_time = (fixed_time < (stop - start)) ? fixed_time : stop - start;
+
+        start = cpuSecond();
+        adaptive = AdaptiveIntegral(0, a, f, tol);
+        stop = cpuSecond();
+        adaptive_time = (adaptive_time < (stop - start)) ? adaptive_time : stop - start;
+    }
+
+    printf("Fixed step: %d evaluations, %.6lf seconds, error %.3e\n", nsteps, fixed_time, fabs(fixed - exact));
+    printf("Adaptive (tolerance %.1e): %ld evaluations, %.6lf seconds, error %.3e, error estimate %.3e\n",
+           tol, adaptive.evals, adaptive_time, fabs(adaptive.result - exact), adaptive.error);
+}
+
+int main(int argc, char *argv[]){
+    int mode = MODE_LIBM;
+    double tol = 1e-10;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:e:")) != -1) {
+        if (opt == 'm' && strcmp(optarg, "libm") == 0) {
+            mode = MODE_LIBM;
+        } else if (opt == 'm' && strcmp(optarg, "simd") == 0) {
+            mode = MODE_SIMD;
+        } else if (opt == 'm' && strcmp(optarg, "adaptive") == 0) {
+            mode = MODE_ADAPTIVE;
+        } else if (opt == 'e') {
+            tol = atof(optarg);
+        } else {
+            fprintf(stderr, "Usage: %s [-m libm|simd|adaptive] [-e tolerance]\n", argv[0]);
+            return 1;
+        }
+    }
+
     printf("Number of threads: %d\n", NTHREADS);
-    TimeCheckParallel();
+    if (mode == MODE_ADAPTIVE)
+        TimeCheckAdaptive(tol);
+    else
+        TimeCheckParallel(mode == MODE_SIMD);
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <cmath>
+#include <cstdio>
+#include <omp.h>
+#include "cubature.h"
+
+#ifdef NTHREADS
+#else
+#error "NTHREADS is not defined. Please specify -DNTHREADS=value during compilation."
+#endif
+
+const long nsteps = 40000000;
+
+/**
+ * @brief 4 / (1 + x^2): integral[0,1] = pi.
+ */
+double Arctan(double x) { return 4.0 / (1.0 + x * x); }
+
+/**
+ * @brief Same midpoint rule as the templated ParallelIntegral, but f is called through
+ *        a function pointer, as in task2.c: one indirect call per point, no vectorization.
+ */
+double ParallelIntegralPtr(double a, double b, double (*f)(double), long nsteps) {
+    const double h = (b - a) / nsteps;
+    double sum = 0.0;
+
+    #pragma omp parallel for schedule(static) reduction(+ : sum)
+    for (long i = 0; i < nsteps; i++) {
+        sum += f(a + h * (i + 0.5));
+    }
+    return sum * h;
+}
+
+/**
+ * @brief Runs fn 20 times and returns the minimum time in seconds.
+ */
+template <class Fn>
+double MinTime(Fn fn) {
+    double min_time = 1e9;
+    for (int i = 0; i < 20; i++) {
+        double start = omp_get_wtime();
+        fn();
+        min_time = std::fmin(min_time, omp_get_wtime() - start);
+    }
+    return min_time;
+}
+
+/**
+ * @brief 1D: the same integral through a function pointer and through a lambda.
+ */
+void TimeCheck1D() {
+    printf("integral[0,1] 4/(1+x^2)dx = pi, nsteps = %ld\n", nsteps);
+
+    double result_ptr = 0, result_tpl = 0;
+    // The pointer is laundered through a volatile so the call is not devirtualized.
+    double (*volatile fptr)(double) = Arctan;
+    double time_ptr = MinTime([&] { result_ptr = ParallelIntegralPtr(0, 1, fptr, nsteps); });
+    double time_tpl = MinTime([&] {
+        result_tpl = ParallelIntegral(0, 1, [](double x) { return 4.0 / (1.0 + x * x); }, nsteps);
+    });
+
+    printf("  function pointer: %.4lf seconds, error %.3e\n", time_ptr, std::fabs(result_ptr - M_PI));
+    printf("  template lambda:  %.4lf seconds, error %.3e\n", time_tpl, std::fabs(result_tpl - M_PI));
+}
+
+/**
+ * @brief D-dimensional Gaussian exp(-|x|^2) over [0,1]^D:
+ *        integral = (sqrt(pi) / 2 * erf(1))^D.
+ */
+template <std::size_t D>
+void TimeCheckGaussian(long n_per_dim, long qmc_points) {
+    Box<D> box;
+    std::array<long, D> n;
+    for (std::size_t d = 0; d < D; d++) {
+        box.lo[d] = 0.0;
+        box.hi[d] = 1.0;
+        n[d] = n_per_dim;
+    }
+    auto f = [](const Point<D> &x) {
+        double r2 = 0.0;
+        for (std::size_t d = 0; d < D; d++) r2 += x[d] * x[d];
+        return std::exp(-r2);
+    };
+    const double exact = std::pow(std::sqrt(M_PI) / 2 * std::erf(1.0), D);
+    const double grid = std::pow(static_cast<double>(n_per_dim), D);
+
+    printf("integral[0,1]^%zu exp(-|x|^2)dx = %.12f\n", D, exact);
+
+    double midpoint = 0, simpson = 0;
+    CubatureResult qmc{};
+    double time_mid = MinTime([&] { midpoint = MidpointCubature(box, n, f); });
+    double time_simp = MinTime([&] { simpson = SimpsonCubature(box, n, f); });
+    double time_qmc = MinTime([&] { qmc = QmcCubature(box, qmc_points, f); });
+
+    printf("  midpoint: %.0f points, %.4lf seconds, error %.3e\n", grid, time_mid, std::fabs(midpoint - exact));
+    printf("  simpson:  %.0f points, %.4lf seconds, error %.3e\n", std::pow(n_per_dim + 1.0 + n_per_dim % 2, D),
+           time_simp, std::fabs(simpson - exact));
+    printf("  qmc:      %ld points, %.4lf seconds, error %.3e, standard error %.3e\n", qmc.evals, time_qmc,
+           std::fabs(qmc.value - exact), qmc.error);
+}
+
+int main() {
+    omp_set_num_threads(NTHREADS);
+    printf("Number of threads: %d\n", NTHREADS);
+
+    TimeCheck1D();
+    TimeCheckGaussian<2>(2000, 500000);
+    TimeCheckGaussian<3>(160, 500000);
+    TimeCheckGaussian<6>(10, 500000);
+}
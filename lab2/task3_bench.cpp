@@ -0,0 +1,141 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "iterative_solver.h"
+
+/*
+ * Sweeps the task3 solver over backends x threads x sizes in one run and reports the time
+ * per iteration of each configuration and the fastest one per size. The system is the one
+ * of task3 (A = I + 1 * 1^T, b = n + 1, solution 1); the matrix of each size is built once.
+ */
+
+struct Options {
+    std::vector<std::string> backends = BackendNames();
+    std::vector<int> threads;
+    std::vector<int> sizes = {1000, 2000, 4000};
+    std::string storage = "dense";
+    std::string type = "double";
+    std::string method = "fixed";
+    int maxIterations = 200;
+};
+
+void Usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [--backends omp-for,omp-region,pool,stealing] [--threads 1,2,4]"
+              << " [--sizes 1000,2000,4000] [--storage dense|csr|structured] [--type float|double|long-double]"
+              << " [--method fixed|auto|chebyshev] [--iterations N]" << std::endl;
+    std::exit(1);
+}
+
+std::vector<std::string> SplitList(const std::string &list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    for (std::string item; std::getline(stream, item, ',');)
+        if (!item.empty()) items.push_back(item);
+    return items;
+}
+
+std::vector<int> SplitIntList(const std::string &list) {
+    std::vector<int> values;
+    for (const std::string &item : SplitList(list)) values.push_back(std::stoi(item));
+    return values;
+}
+
+Options ParseOptions(int argc, char *argv[]) {
+    Options opts;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string key = argv[i];
+            if (i + 1 >= argc) Usage(argv[0]);
+            std::string value = argv[++i];
+            if (key == "--backends") {
+                opts.backends = SplitList(value);
+            } else if (key == "--threads") {
+                opts.threads = SplitIntList(value);
+            } else if (key == "--sizes") {
+                opts.sizes = SplitIntList(value);
+            } else if (key == "--storage") {
+                opts.storage = value;
+            } else if (key == "--type" && (value == "float" || value == "double" || value == "long-double")) {
+                opts.type = value;
+            } else if (key == "--method") {
+                opts.method = value;
+            } else if (key == "--iterations") {
+                opts.maxIterations = std::stoi(value);
+            } else {
+                Usage(argv[0]);
+            }
+        }
+    } catch (const std::invalid_argument &) {
+        Usage(argv[0]);
+    } catch (const std::out_of_range &) {
+        Usage(argv[0]);
+    }
+
+    // Names are checked before the sweep starts, not when it reaches them
+    try {
+        for (const std::string &name : opts.backends) MakeBackend(name, 1);
+        MakeSystemOperator<double>(opts.storage, 1, 1);
+        ParseIterationKind(opts.method);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << std::endl;
+        Usage(argv[0]);
+    }
+    // Default: 1, 2, 4, ... up to the number of cores
+    if (opts.threads.empty()) {
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned t = 1; t <= cores; t *= 2) opts.threads.push_back(t);
+    }
+    return opts;
+}
+
+template <class T>
+void Sweep(const Options &opts) {
+    SolverOptions solver;
+    solver.kind = ParseIterationKind(opts.method);
+    solver.maxIterations = opts.maxIterations;
+    int maxThreads = 1;
+    for (int t : opts.threads) maxThreads = std::max(maxThreads, t);
+
+    std::printf("%8s %8s %12s %10s %12s %14s %12s\n", "size", "threads", "backend", "iterations", "ms/iteration",
+                "residual", "setup, s");
+    for (int n : opts.sizes) {
+        std::unique_ptr<BasicLinearOperator<T>> a = MakeSystemOperator<T>(opts.storage, n, maxThreads);
+        std::vector<T> b(n, T(n + 1)), x(n);
+
+        double best = 0.0;
+        std::string bestConfig;
+        for (int nthreads : opts.threads) {
+            for (const std::string &name : opts.backends) {
+                std::unique_ptr<ParallelBackend> backend = MakeBackend(name, nthreads);
+                std::fill(x.begin(), x.end(), T(0));
+                SolverResult result = SolveSimpleIteration(*a, b, x, *backend, solver);
+
+                double perIteration = result.seconds / result.iterations * 1e3;
+                std::printf("%8d %8d %12s %10d %12.4f %14.3Le %12.4f\n", n, nthreads, backend->Name(),
+                            result.iterations, perIteration, result.residual, result.setupSeconds);
+                if (bestConfig.empty() || perIteration < best) {
+                    best = perIteration;
+                    bestConfig = std::string(backend->Name()) + ", " + std::to_string(nthreads) + " threads";
+                }
+            }
+        }
+        std::printf("fastest for size %d: %s (%.4f ms/iteration)\n", n, bestConfig.c_str(), best);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options opts = ParseOptions(argc, argv);
+    std::cout << "storage: " << opts.storage << ", type: " << opts.type << ", method: " << opts.method
+              << ", at most " << opts.maxIterations << " iterations" << std::endl;
+
+    if (opts.type == "float") Sweep<float>(opts);
+    if (opts.type == "double") Sweep<double>(opts);
+    if (opts.type == "long-double") Sweep<long double>(opts);
+    return 0;
+}
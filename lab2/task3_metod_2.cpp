@@ -3,7 +3,9 @@
 #include <omp.h>
 #include <cmath>
 #include <iomanip>
-#include <random>
+#include <stdexcept>
+#include <string>
+#include "iterative_solver.h"
 
 #ifdef NTHREADS
 #else
@@ -20,181 +22,80 @@ double epsilon = 0.00001;
 const int kMAX_ITERATIONS = 10000000; 
 
 /**
- * @brief Returns the current time in seconds.
- *        Time is measured using a system call.
- * @return Current time in seconds, including fractional part 
- *        with nanosecond precision.
+ * @brief Implements the simple iteration method for solving systems of linear equations
+ *        in one parallel region (SolveSimpleIteration on the omp-region backend).
+ * @param matrixA Matrix of the system.
+ * @param kind Fixed step, step from the estimated spectrum or Chebyshev semi-iteration.
+ * @return The time taken to execute the method.
  */
-double CpuSecond() {
-    struct timespec ts;
-    timespec_get(&ts, TIME_UTC);
-    return ((double)ts.tv_sec + (double)ts.tv_nsec * 1.e-9);
-}
-
-/**
- * @brief Compute matrix-vector product vecRes[MATRIX_SIZE] = matrix[MATRIX_SIZE][MATRIX_SIZE] * vec[MATRIX_SIZE].
- * @warning the matrix must be represented in linear form.
- */
-void MatrixVectorProductOmp(const long double *matrix, const long double *vec, long double *vecRes, int &lowerBound, int &upperBound) {
-    for (int i = lowerBound; i <= upperBound; i++) {
-        vecRes[i] = 0;
-        for (int j = 0; j < MATRIX_SIZE; j++) {
-            vecRes[i] += matrix[i * MATRIX_SIZE + j] * vec[j];
-        }
-    }
-}
-
-/**
- * @brief Compute vector difference vec1[n] -= vec2[MATRIX_SIZE].
- * @warning Both vectors must have the same size.
- */
-void SubtractVecFromVec(long double *vec1, const long double *vec2, int &lowerBound, int &upperBound){
-    for (int i = lowerBound; i <= upperBound; i++){
-        vec1[i] -= vec2[i];
-    }
-}
-
-/**
- * @brief Compute scalar-vector product vec[MATRIX_SIZE] *= scalar.
- */
-void MultiplyVecByScalar(long double *vec, const long double &scalar, int &lowerBound, int &upperBound){
-    for (int i = lowerBound; i <= upperBound; i++){
-        vec[i] *= scalar;
-    }
-}
-
-double VecL2NormOmp(const long double *vec, int &lowerBound, int &upperBound){
-    long double l2NormOmp = 0.0;
-    for (int i = lowerBound; i <= upperBound; i++){
-        l2NormOmp += vec[i] * vec[i];
+double IterationMethod(const LinearOperator &matrixA, IterationKind kind) {
+    std::vector<long double> vecB(MATRIX_SIZE, MATRIX_SIZE + 1);
+    std::vector<long double> vecX(MATRIX_SIZE, 0.0);
+
+    SolverOptions options;
+    options.kind = kind;
+    options.epsilon = epsilon;
+    options.step = kITERATION_STEP;
+    options.maxIterations = kMAX_ITERATIONS;
+
+    OmpRegionBackend backend(NTHREADS);
+    SolverResult result = SolveSimpleIteration(matrixA, vecB, vecX, backend, options);
+
+    if (kind != IterationKind::Fixed) {
+        std::cout << "Spectrum estimate: [" << result.spectrum.lambdaMin << ", " << result.spectrum.lambdaMax << "] ("
+                  << result.spectrum.products << " products)" << std::endl;
     }
-    return l2NormOmp;
-}
 
-double IterationMethod() {
-    long double* matrixAData = new long double[MATRIX_SIZE * MATRIX_SIZE];
-    long double* vecBData = new long double[MATRIX_SIZE];
-    long double* vecX = new long double[MATRIX_SIZE];
-    long double* vecTemp = new long double[MATRIX_SIZE];
-
-    #pragma omp parallel num_threads(NTHREADS)
-    {
-        int numThreads = omp_get_num_threads();
-        int threadId = omp_get_thread_num();
-        int itemsPerThread = MATRIX_SIZE / numThreads;
-        int lowerBound = threadId * itemsPerThread;
-        int upperBound = (threadId == numThreads - 1) ? (MATRIX_SIZE - 1) : (lowerBound + itemsPerThread - 1);
-        for (int i = lowerBound; i <= upperBound; i++) {
-            for (int j = 0; j < MATRIX_SIZE; j++)
-                matrixAData[i * MATRIX_SIZE + j] = (i == j) ? 2.0 : 1.0;
-            vecBData[i] = MATRIX_SIZE+1;
-            vecX[i] = 0.0;
-        }
+    if (!result.converged) {
+        std::cerr << "Error: Exceeded maximum number of iterations (" << kMAX_ITERATIONS << ")." << std::endl;
+        exit(13);
     }
 
-    const long double* matrixA = matrixAData; 
-    const long double* vecB = vecBData; 
-
-    double l2VecB = 0.0, numerator = 0.0;
-    bool stop = false; 
-
-    double startTime = CpuSecond();
-
-    #pragma omp parallel num_threads(NTHREADS)
-    {   
-        int numThreads = omp_get_num_threads();
-        int threadId = omp_get_thread_num();
-        int itemsPerThread = MATRIX_SIZE / numThreads;
-        int lowerBound = threadId * itemsPerThread;
-        int upperBound = (threadId == numThreads - 1) ? (MATRIX_SIZE - 1) : (lowerBound + itemsPerThread - 1);
-
-        double numeratorPart;
-
-        double l2VecBPart =  VecL2NormOmp(vecB, lowerBound, upperBound);
-        #pragma omp atomic
-        l2VecB += l2VecBPart;
-
-        #pragma omp barrier
-
-        #pragma omp single
-        epsilon *= sqrt(l2VecB);
-        
-        while(!stop) {
-            //vecTemp = matrixA * vecX
-            MatrixVectorProductOmp(matrixA, vecX, vecTemp, lowerBound, upperBound);
-
-            //vecTemp = matrixA*vecX - b
-            SubtractVecFromVec(vecTemp, vecB, lowerBound, upperBound);
-
-            numeratorPart = VecL2NormOmp(vecTemp,  lowerBound, upperBound);
-
-            #pragma omp atomic
-            numerator += numeratorPart;
-            #pragma omp barrier
-
-            #pragma omp single
-            {
-                if (sqrt(numerator) < epsilon) {
-                    stop = true; 
-                }
-
-                if (iterationCount >= MAX_ITERATIONS) {
-                    std::cerr << "Error: Exceeded maximum number of iterations (" << MAX_ITERATIONS << ")." << std::endl;
-                    delete[] matrixAData;
-                    delete[] vecBData;
-                    delete[] vecX;
-                    delete[] vecTemp;
-                    exit(13);
-                }
-
-                numerator = 0.0; 
-            }
-
-
-            if (stop) break; 
-
-            //vecTemp = ITERATION_STEP * (matrixA*vecX - b)
-            MultiplyVecByScalar(vecTemp, kITERATION_STEP, lowerBound, upperBound);
-    
-            //vecX -= ITERATION_STEP * (matrixA*vecX - b)
-            SubtractVecFromVec(vecX, vecTemp, lowerBound, upperBound);
-        }
-    }
-
-    double endTime = CpuSecond();
-
     long double sumAbsoluteError = 0.0;
     long double sumRelativeError = 0.0;
 
-    #pragma omp parallel for num_threads(NTHREADS) schedule(static) reduction(+:sumAbsoluteError,sumRelativeError)
+    #pragma omp parallel for num_threads(NTHREADS) schedule(static) reduction(+:sumAbsoluteError, sumRelativeError)
     for (int i = 0; i < MATRIX_SIZE; i++) {
         long double absoluteError = std::abs(vecX[i] - 1.0);
         long double relativeError = std::abs((vecX[i] - 1.0) / 1.0);
-
+        
         sumAbsoluteError += absoluteError;
         sumRelativeError += relativeError;
     }
 
+    std::cout << "Number of iterations performed: " << result.iterations << std::endl;
     std::cout << "Sum of absolute errors: " << sumAbsoluteError << std::endl;
     std::cout << "Sum of relative errors: " << sumRelativeError << std::endl;
 
-    delete[] matrixAData;
-    delete[] vecBData;
-    delete[] vecX;
-    delete[] vecTemp;
-
-    return endTime - startTime;
+    return result.setupSeconds + result.seconds;
 }
 
+/**
+ * @param argv[1] Storage of the matrix: dense (default), csr or structured (diagonal + rank one, O(n)).
+ * @param argv[2] Iteration: fixed (default, kITERATION_STEP), auto (optimal step for the estimated
+ *        spectrum) or chebyshev (Chebyshev semi-iteration on the estimated spectrum).
+ */
 int main(int argc, char* argv[]) {
-    int matrixSize = MATRIX_SIZE;
+    std::string kind = (argc > 1) ? argv[1] : "dense";
+    IterationKind method;
+    std::unique_ptr<LinearOperator> matrixA;
+    try {
+        method = ParseIterationKind((argc > 2) ? argv[2] : "fixed");
+        matrixA = MakeSystemOperator(kind, MATRIX_SIZE, NTHREADS);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
     std::cout << "Program using Simple Iteration method for solving linear systems (CLAY)" << std::endl;
     std::cout << "CLAY : A[" << MATRIX_SIZE << "][" << MATRIX_SIZE << "] * x[" << MATRIX_SIZE << "] = b[" << MATRIX_SIZE << "]\n";
     std::cout << "Number of threads: " << NTHREADS << std::endl;
-    std::cout << "Memory used: " << static_cast<long double>((MATRIX_SIZE * MATRIX_SIZE + MATRIX_SIZE + MATRIX_SIZE + MATRIX_SIZE) * sizeof(long double)) / (1024 * 1024) << " MiB\n";
+    std::cout << "Matrix storage: " << matrixA->Name() << std::endl;
+    std::cout << "Memory used: " << static_cast<long double>(matrixA->MemoryBytes() + 3 * MATRIX_SIZE * sizeof(long double)) / (1024 * 1024) << " MiB\n";
     
-    double time = IterationMethod();
+    std::cout << "Method: " << ((argc > 2) ? argv[2] : "fixed") << std::endl;
+
+    double time = IterationMethod(*matrixA, method);
     std::cout << "Your calculations took " << std::fixed << std::setprecision(4) << time << " seconds." << std::endl;
     
     return 0;
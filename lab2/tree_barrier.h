@@ -0,0 +1,112 @@
+#ifndef TREE_BARRIER_H
+#define TREE_BARRIER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+/*
+ * Barrier fused with a sum over the threads of a persistent parallel region (all-reduce):
+ * every thread passes its partial value and gets the total back, in one synchronization.
+ * Threads 0..n-1 form a tree with fan-in kTreeFanIn. Each thread waits for its children,
+ * adds their values to its own and publishes the result in its slot; the root (thread 0)
+ * publishes the total and releases everybody with one flag. Every slot has its own cache
+ * line, so a thread only waits on lines written by its children and by the root.
+ */
+
+/**
+ * @brief Children per node of the combining tree.
+ */
+constexpr int kTreeFanIn = 4;
+
+/**
+ * @brief Failed checks of a spin wait before the waiting thread starts yielding its core.
+ */
+constexpr int kSpinsBeforeYield = 1024;
+
+/**
+ * @brief Spins on the predicate; after spinsBeforeYield failed checks yields the core on
+ *        every check, so the thread being waited for can run if it shares the core.
+ */
+template <class Done>
+inline void SpinUntil(Done done, int spinsBeforeYield) {
+    for (int spins = 0; !done(); spins++) {
+        if (spins < spinsBeforeYield) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+template <class T>
+class TreeAllReduce {
+public:
+    /**
+     * @param nthreads Number of threads taking part; each must call Sum with its own id
+     *        in [0, nthreads) the same number of times.
+     */
+    explicit TreeAllReduce(int nthreads)
+        : nthreads_(nthreads),
+          // With more threads than cores the awaited thread may wait for our core: yield at once
+          spins_(static_cast<unsigned>(nthreads) <= std::thread::hardware_concurrency() ? kSpinsBeforeYield : 0),
+          slots_(new Slot[nthreads]) {}
+
+    int Threads() const { return nthreads_; }
+
+    /**
+     * @brief Sum of value over all threads. Returns after every thread has entered the call
+     *        of the same round, so it is also a barrier.
+     */
+    T Sum(int threadId, T value) {
+        Slot &self = slots_[threadId];
+        const unsigned round = ++self.round;
+
+        int first = kTreeFanIn * threadId + 1;
+        for (int child = first; child < first + kTreeFanIn && child < nthreads_; child++) {
+            const Slot &slot = slots_[child];
+            SpinUntil([&] { return slot.arrived.load(std::memory_order_acquire) == round; }, spins_);
+            value += slot.value;
+        }
+
+        if (threadId == 0) {
+            release_.total = value;
+            release_.round.store(round, std::memory_order_release);
+            return value;
+        }
+
+        self.value = value;
+        self.arrived.store(round, std::memory_order_release);
+        SpinUntil([&] { return release_.round.load(std::memory_order_acquire) == round; }, spins_);
+        return release_.total;
+    }
+
+    /**
+     * @brief Barrier without a value.
+     */
+    void Wait(int threadId) { Sum(threadId, T()); }
+
+private:
+    // Written by its own thread, read by its parent.
+    struct alignas(64) Slot {
+        std::atomic<unsigned> arrived{0};
+        unsigned round = 0;
+        T value{};
+    };
+
+    // Written by the root, read by everybody.
+    struct alignas(64) Release {
+        std::atomic<unsigned> round{0};
+        T total{};
+    };
+
+    int nthreads_;
+    int spins_;
+    std::unique_ptr<Slot[]> slots_;
+    Release release_;
+};
+
+#endif  // TREE_BARRIER_H
@@ -9,12 +9,14 @@ collects execution time, and saves performance metrics to a CSV file.
 import argparse
 import csv
 import itertools
+import os
 import subprocess
-from typing import List, Tuple
+from typing import List, Optional, Tuple
 
 
 def compile_program(source: str, output: str,
-                    matrix_size: int, threads: int, container: int) -> bool:
+                    matrix_size: int, threads: int, container: int, storage: str,
+                    vectors: int, pool: int, pin: bool) -> bool:
     """
     Compile the C++ program with the given flags.
 
@@ -24,6 +26,10 @@ def compile_program(source: str, output: str,
         matrix_size: Size of the matrix to define via macro.
         threads: Number of threads to define via macro.
         container: ID of the thread container type to define via macro.
+        storage: Matrix storage type (LONG_DOUBLE, DOUBLE, FLOAT or BF16).
+        vectors: Number of vectors multiplied by the matrix in one pass.
+        pool: 1 - persistent thread pool, 0 - threads created per call.
+        pin: Pin pool threads to cores.
 
     Returns:
         True if compilation was successful, False otherwise.
@@ -31,7 +37,10 @@ def compile_program(source: str, output: str,
     compile_cmd = [
         "g++", "-std=c++20", f"-DMATRIX_SIZE={matrix_size}",
         f"-DNTHREADS={threads}", f"-DTHREAD_CONTAINER={container}",
+        f"-DTHREAD_POOL={pool}", f"-DPIN_THREADS={int(pin)}",
+        f"-DUSE_{storage}", f"-DNVECTORS={vectors}", "-I../../common",
         "-O2",  # Optimization flag
+        "-pthread",
         "-o", output, source
     ]
 
@@ -45,18 +54,20 @@ def compile_program(source: str, output: str,
     return True
 
 
-def run_program(executable: str) -> Tuple[bool, float]:
+def run_program(executable: str, matrix_file: Optional[str] = None) -> Tuple[bool, float]:
     """
     Run the compiled program and extract execution time from its output.
 
     Args:
         executable: Path to the compiled executable.
+        matrix_file: Matrix file to map instead of building the matrix in memory.
 
     Returns:
         A tuple (success flag, execution time in milliseconds).
     """
     try:
-        result = subprocess.run([f"./{executable}"], capture_output=True, text=True, timeout=600)
+        cmd = [f"./{executable}"] + ([matrix_file] if matrix_file else [])
+        result = subprocess.run(cmd, capture_output=True, text=True, timeout=600)
         if result.returncode != 0:
             print("Execution failed:")
             print(result.stderr)
@@ -83,6 +94,16 @@ def main() -> None:
     parser.add_argument("--source", type=str, default="task1.cpp", help="Path to the C++ source file.")
     parser.add_argument("--output", type=str, default="task1", help="Name of the output executable.")
     parser.add_argument("--trials", type=int, default=5, help="Number of trials per configuration.")
+    parser.add_argument("--storage", type=str, nargs="+", default=["LONG_DOUBLE"],
+                        help="Matrix storage types: LONG_DOUBLE DOUBLE FLOAT BF16.")
+    parser.add_argument("--vectors", type=int, nargs="+", default=[1],
+                        help="Numbers of vectors multiplied by the matrix in one pass.")
+    parser.add_argument("--matrix-dir", type=str, default=None,
+                        help="Directory for matrix files; the matrix is then mapped from disk "
+                             "(written once per size and storage) instead of built in memory.")
+    parser.add_argument("--pool", type=int, nargs="+", default=[1],
+                        help="1 - persistent thread pool, 0 - threads created per call (e.g. --pool 0 1).")
+    parser.add_argument("--pin", action="store_true", help="Pin pool threads to cores.")
     parser.add_argument("--csv", type=str, default="results.csv", help="Path to the output CSV file.")
 
     args = parser.parse_args()
@@ -93,19 +114,27 @@ def main() -> None:
 
     with open(args.csv, mode="w", newline="") as file:
         writer = csv.writer(file)
-        writer.writerow(["MatrixSize", "Threads", "Container", "AvgTime_ms"])
+        writer.writerow(["MatrixSize", "Threads", "Container", "Pool", "Storage", "Vectors", "AvgTime_ms",
+                         "AvgTimePerVector_ms"])
 
-        for matrix_size, threads, container in itertools.product(matrix_sizes, threads_list, containers):
-            print(f"\nTesting: MATRIX_SIZE={matrix_size}, NTHREADS={threads}, CONTAINER={container}")
+        for matrix_size, threads, container, pool, storage, vectors in itertools.product(
+                matrix_sizes, threads_list, containers, args.pool, args.storage, args.vectors):
+            print(f"\nTesting: MATRIX_SIZE={matrix_size}, NTHREADS={threads}, CONTAINER={container}, "
+                  f"POOL={pool}, STORAGE={storage}, NVECTORS={vectors}")
 
-            if not compile_program(args.source, args.output, matrix_size, threads, container):
+            if not compile_program(args.source, args.output, matrix_size, threads, container, storage, vectors,
+                                   pool, args.pin):
                 continue
 
+            matrix_file = None
+            if args.matrix_dir:
+                matrix_file = os.path.join(args.matrix_dir, f"matrix_{matrix_size}_{storage.lower()}.bin")
+
             times: List[float] = []
 
             for trial in range(args.trials):
                 print(f"Trial {trial + 1}...", end=' ')
-                success, elapsed = run_program(args.output)
+                success, elapsed = run_program(args.output, matrix_file)
                 if success:
                     print(f"{elapsed:.4f} ms")
                     times.append(elapsed)
@@ -115,7 +144,8 @@ def main() -> None:
 
             if times:
                 avg_time = sum(times) / len(times)
-                writer.writerow([matrix_size, threads, container, round(avg_time, 4)])
+                writer.writerow([matrix_size, threads, container, pool, storage, vectors, round(avg_time, 4),
+                                 round(avg_time / vectors, 4)])
             else:
                 print("Не удалось получить результаты для этой конфигурации.")
 
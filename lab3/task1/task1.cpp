@@ -1,4 +1,8 @@
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
 #include <stdlib.h>
 #include <thread>
 #include <cinttypes>
@@ -7,6 +11,9 @@
 #include <deque>
 #include <list>
 #include <forward_list>
+#include "arena.h"
+#include "matrix_file.h"
+#include "thread_pool.h"
 
 #ifdef NTHREADS
 #else
@@ -37,6 +44,86 @@
 #error "Invalid THREAD_CONTAINER value. Use 1-5"
 #endif
 
+/*
+ * -DTHREAD_POOL=1 (default): parallel calls run on a pool of NTHREADS threads started once,
+ * optionally pinned to cores (-DPIN_THREADS=1). -DTHREAD_POOL=0: every call creates and joins
+ * its own NTHREADS threads, kept in CONTAINER (the THREAD_CONTAINER comparison).
+ */
+#ifndef THREAD_POOL
+#define THREAD_POOL 1
+#endif
+
+#ifndef PIN_THREADS
+#define PIN_THREADS 0
+#endif
+
+/*
+ * Pages of the matrix and vector buffers (see arena.h): 0 - default, 1 - transparent huge
+ * pages (default), 2 - explicit huge pages (MAP_HUGETLB, falls back to transparent ones).
+ */
+#ifndef ARENA_PAGES
+#define ARENA_PAGES 1
+#endif
+
+/*
+ * Number of vectors multiplied by the matrix in one pass (-DNVECTORS=k, 1 by default).
+ * Vectors and results are stored interleaved: element j of vector v is vec[j * NVECTORS + v].
+ */
+#ifndef NVECTORS
+#define NVECTORS 1
+#endif
+
+/*
+ * Matrix storage type: -DUSE_DOUBLE, -DUSE_FLOAT or -DUSE_BF16 (long double by default).
+ * Narrow types are widened on load and accumulated in double; the vector and the result
+ * are kept in the accumulation type. 40000x40000 takes ~25 GB as long double,
+ * 12.8 GB as double, 6.4 GB as float and 3.2 GB as bf16.
+ */
+#if defined(USE_DOUBLE)
+using matrix_t = double;
+using accum_t = double;
+#define STORAGE_NAME "double"
+#elif defined(USE_FLOAT)
+using matrix_t = float;
+using accum_t = double;
+#define STORAGE_NAME "float"
+#elif defined(USE_BF16)
+#include "bf16.h"
+using matrix_t = bf16_t;
+using accum_t = double;
+#define STORAGE_NAME "bf16"
+#else
+using matrix_t = long double;
+using accum_t = long double;
+#define STORAGE_NAME "long double"
+#endif
+
+/**
+ * @brief Converts a matrix element to the accumulation type.
+ */
+inline accum_t MatrixLoad(matrix_t value) {
+#if defined(USE_BF16)
+    return bf16_to_float(value);
+#else
+    return value;
+#endif
+}
+
+/**
+ * @brief Rounds a value to the matrix storage type.
+ */
+inline matrix_t MatrixStore(accum_t value) {
+#if defined(USE_BF16)
+    return bf16_from_float(static_cast<float>(value));
+#else
+    return static_cast<matrix_t>(value);
+#endif
+}
+
+/*
+ * Matrix bytes per streamed panel when the matrix is mapped from a file.
+ */
+constexpr size_t kPanelBytes = 16u << 20;
 
 /**
  * @brief Displays an error message in Stderr.
@@ -48,13 +135,12 @@ void fatal(const char *message) {
 }
 
 /**
- * @brief calls malloc and makes an error if the value is null,
- * and returns the result only if the value is excellent from zero.
+ * @brief Takes size bytes from the arena, page-aligned, and makes an error if it is full.
  * @param size Size isolated memory.
  */
-void *xmalloc(size_t size) {
-    void *value = malloc(size);
-    if (value == nullptr) fatal("Virtual memory exhausted");
+void *xalloc(Arena *arena, size_t size) {
+    void *value = arena_alloc(arena, size, 4096);
+    if (value == nullptr) fatal("Arena exhausted");
     return value;
 }
 
@@ -62,116 +148,293 @@ void *xmalloc(size_t size) {
  * @brief Computes matrix-vector product in a specified range of rows.
  * @warning the matrix must be represented in linear form.
  */
-void MatrixVectorProductThread(const long double *matrix, const long double *vec, long double *vecRes, int lowerBound,
+void MatrixVectorProductThread(const matrix_t *matrix, const accum_t *vec, accum_t *vecRes, int lowerBound,
                                int upperBound) {
-    for (size_t i = lowerBound; i <= upperBound; i++) {
-        vecRes[i] = 0;
+    for (int i = lowerBound; i <= upperBound; i++) {
+        const matrix_t *row = matrix + static_cast<size_t>(i) * MATRIX_SIZE;
+        accum_t sum = 0;
         for (size_t j = 0; j < MATRIX_SIZE; j++) {
-            vecRes[i] += matrix[i * MATRIX_SIZE + j] * vec[j];
+            sum += MatrixLoad(row[j]) * vec[j];
         }
+        vecRes[i] = sum;
+    }
+}
+
+/*
+ * Column tile of the batched product: the vectors' slice of the tile takes about 128 KiB
+ * and stays in L2 while the thread walks its rows, so each matrix element is read from
+ * memory once and used for all NVECTORS vectors.
+ */
+constexpr size_t kColumnTile = std::max<size_t>(64, 128 * 1024 / (NVECTORS * sizeof(accum_t)));
+
+/**
+ * @brief Computes matrix times NVECTORS vectors in a specified range of rows.
+ * @warning the matrix must be represented in linear form, vectors - interleaved.
+ */
+void MatrixMultiVectorProductThread(const matrix_t *matrix, const accum_t *vecs, accum_t *res, int lowerBound,
+                                    int upperBound) {
+    std::fill(res + static_cast<size_t>(lowerBound) * NVECTORS, res + (static_cast<size_t>(upperBound) + 1) * NVECTORS,
+              accum_t(0));
+
+    for (size_t j0 = 0; j0 < MATRIX_SIZE; j0 += kColumnTile) {
+        const size_t j1 = std::min<size_t>(j0 + kColumnTile, MATRIX_SIZE);
+        for (int i = lowerBound; i <= upperBound; i++) {
+            const matrix_t *row = matrix + static_cast<size_t>(i) * MATRIX_SIZE;
+            accum_t *out = res + static_cast<size_t>(i) * NVECTORS;
+            for (size_t j = j0; j < j1; j++) {
+                const accum_t x = MatrixLoad(row[j]);
+                const accum_t *vj = vecs + j * NVECTORS;
+                for (size_t v = 0; v < NVECTORS; v++) {
+                    out[v] += x * vj[v];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Calls product(r0, r1) over panels of rows lowerBound..upperBound (inclusive bounds).
+ *        For a matrix mapped from a file (mf != nullptr) the next panel is handed to readahead
+ *        before the current one is computed, so disk reads overlap with the product; for a
+ *        matrix in memory the whole range is one panel.
+ */
+template <class Product>
+void StreamPanels(const MatrixFile *mf, int lowerBound, int upperBound, Product product) {
+    if (mf == nullptr) {
+        product(lowerBound, upperBound);
+        return;
+    }
+    const size_t panel = matrix_file_panel_rows(mf, kPanelBytes, 1);
+    const size_t end = static_cast<size_t>(upperBound) + 1;
+    matrix_file_advise(mf, lowerBound, std::min(lowerBound + panel, end), MADV_WILLNEED);
+    for (size_t r0 = lowerBound; r0 < end; r0 += panel) {
+        const size_t r1 = std::min(r0 + panel, end);
+        matrix_file_advise(mf, r1, std::min(r1 + panel, end), MADV_WILLNEED);
+        product(static_cast<int>(r0), static_cast<int>(r1 - 1));
+    }
+}
+
+/**
+ * @brief Fills rows [r0, r1) of a matrix file with default values; rows points to row r0.
+ */
+void FillMatrixRows(void *rows, size_t r0, size_t r1, size_t cols) {
+    matrix_t *matrix = static_cast<matrix_t *>(rows);
+    for (size_t i = r0; i < r1; i++) {
+        for (size_t j = 0; j < cols; j++)
+            matrix[(i - r0) * cols + j] = MatrixStore(i + j);
     }
 }
 
 /**
  * @brief Initializes rows of the matrix from lb to ub with default values.
  */
-void ParallelInitMatrix(long double *matrix, const int lowerBound, const int upperBound) {
-    for (size_t i = lowerBound; i <= upperBound; i++) {
+void ParallelInitMatrix(matrix_t *matrix, const int lowerBound, const int upperBound) {
+    for (int i = lowerBound; i <= upperBound; i++) {
         for (size_t j = 0; j < MATRIX_SIZE; j++)
-            matrix[i * MATRIX_SIZE + j] = i + j;
+            matrix[static_cast<size_t>(i) * MATRIX_SIZE + j] = MatrixStore(i + j);
     }
 }
 
 /**
- * @brief Initializes part of a vector[lb:ub] with default values.
+ * @brief Initializes elements lb..ub of all NVECTORS vectors with default values: vector v holds j + v.
  */
-void ParallelInitVec(long double *vec, const int lowerBound, const int upperBound) {
-    for (size_t i = lowerBound; i <= upperBound; i++) {
-        vec[i] = i;
+void ParallelInitVec(accum_t *vec, const int lowerBound, const int upperBound) {
+    for (int i = lowerBound; i <= upperBound; i++) {
+        for (size_t v = 0; v < NVECTORS; v++) {
+            vec[static_cast<size_t>(i) * NVECTORS + v] = i + v;
+        }
     }
 }
 
 /**
- * @brief Initializes matrix and vectors in parallel using multiple threads.
+ * @brief The pool all parallel calls run on; started by the first call.
  */
-void ParallelDataInitialization(long double *matrix, long double *vec1) {
-    CONTAINER<std::jthread> threads(NTHREADS);  // Use vector instead of array for threads
-    int items_per_thread = MATRIX_SIZE / NTHREADS;
+ThreadPool<CONTAINER> &Pool() {
+    static ThreadPool<CONTAINER> pool(NTHREADS, PIN_THREADS);
+    return pool;
+}
 
-    for (size_t i = 0; i < NTHREADS; i++) {
+/**
+ * @brief Calls rows(lb, ub) for each of the NTHREADS row ranges (inclusive bounds) in parallel,
+ *        range i always on thread i of the pool, so rows are touched by the thread that
+ *        initialized them.
+ */
+template <class Rows>
+void ParallelRows(Rows rows) {
+    int items_per_thread = MATRIX_SIZE / NTHREADS;
+    auto range = [items_per_thread, &rows](int i) {
         int lb = i * items_per_thread;
         int ub = (i == NTHREADS - 1) ? (MATRIX_SIZE - 1) : (lb + items_per_thread - 1);
-        threads[i] = std::jthread([matrix, vec1, lb, ub] {
-            ParallelInitMatrix(matrix, lb, ub);
-            ParallelInitVec(vec1, lb, ub);
-        });
+        rows(lb, ub);
+    };
+
+#if THREAD_POOL
+    Pool().Run(range);
+#else
+    CONTAINER<std::jthread> threads(NTHREADS);
+    int i = 0;
+    for (std::jthread &thread : threads) {
+        thread = std::jthread(range, i++);
     }
+#endif
+}
+
+/**
+ * @brief Initializes matrix and vectors in parallel using multiple threads.
+ *        A null matrix (mapped from a file) is left as is.
+ */
+void ParallelDataInitialization(matrix_t *matrix, accum_t *vec1) {
+    ParallelRows([matrix, vec1](int lb, int ub) {
+        if (matrix != nullptr) ParallelInitMatrix(matrix, lb, ub);
+        ParallelInitVec(vec1, lb, ub);
+    });
+}
+
+/**
+ * @brief Bytes of the arena InitTestData takes (page-aligned blocks).
+ */
+size_t TestDataBytes(bool mapped) {
+    const size_t page = 4096;
+    size_t matrix = mapped ? 0 : sizeof(matrix_t) * MATRIX_SIZE * MATRIX_SIZE;
+    size_t vector = sizeof(accum_t) * MATRIX_SIZE * NVECTORS;
+    return arena_round_up(matrix, page) + 2 * arena_round_up(vector, page);
 }
 
 /**
- * @brief Allocates memory and initializes test data for matrix and vectors.
+ * @brief Takes memory from the arena and initializes test data for matrix and vectors.
+ *        With mapped == true the matrix comes from a file and only the vectors are created.
+ *        Rows are first written by the pool threads that multiply them (NUMA first touch).
  */
-void InitTestData(long double *&a, long double *&b, long double *&c) {
-    a = static_cast<long double *>(xmalloc(sizeof(*a) * MATRIX_SIZE * MATRIX_SIZE));
-    b = static_cast<long double *>(xmalloc(sizeof(*b) * MATRIX_SIZE));
-    c = static_cast<long double *>(xmalloc(sizeof(*c) * MATRIX_SIZE));
+void InitTestData(Arena *arena, matrix_t *&a, accum_t *&b, accum_t *&c, bool mapped = false) {
+    if (!mapped) a = static_cast<matrix_t *>(xalloc(arena, sizeof(*a) * MATRIX_SIZE * MATRIX_SIZE));
+    b = static_cast<accum_t *>(xalloc(arena, sizeof(*b) * MATRIX_SIZE * NVECTORS));
+    c = static_cast<accum_t *>(xalloc(arena, sizeof(*c) * MATRIX_SIZE * NVECTORS));
 
-    ParallelDataInitialization(a, b);
+    ParallelDataInitialization(mapped ? nullptr : a, b);
 }
 
 /**
  * @brief Computes matrix-vector multiplication in parallel using multiple threads.
+ * @param mf File the matrix is mapped from (rows are streamed in panels), or nullptr.
  */
-void ParallelMatrixVectorMultiply(const long double *a, const long double *b, long double *c) {
-    CONTAINER<std::jthread> threads(NTHREADS);  // Use vector instead of array for threads
-    int items_per_thread = MATRIX_SIZE / NTHREADS;
+void ParallelMatrixVectorMultiply(const matrix_t *a, const accum_t *b, accum_t *c, const MatrixFile *mf = nullptr) {
+    ParallelRows([a, b, c, mf](int lb, int ub) {
+        StreamPanels(mf, lb, ub, [a, b, c](int r0, int r1) {
+            if constexpr (NVECTORS == 1) {
+                MatrixVectorProductThread(a, b, c, r0, r1);
+            } else {
+                MatrixMultiVectorProductThread(a, b, c, r0, r1);
+            }
+        });
+    });
+}
 
-    for (size_t i = 0; i < NTHREADS; i++) {
-        int lb = i * items_per_thread;
-        int ub = (i == NTHREADS - 1) ? (MATRIX_SIZE - 1) : (lb + items_per_thread - 1);
-        threads[i] = std::jthread(MatrixVectorProductThread, a, b, c, lb, ub);
+/**
+ * @brief Average cost of one parallel call with empty work, in microseconds: thread creation
+ *        and joining without the pool, handing out and collecting the call with it.
+ */
+double DispatchOverhead(int calls = 2000) {
+    ParallelRows([](int, int) {});
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < calls; i++) {
+        ParallelRows([](int, int) {});
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / calls;
+}
+
+/**
+ * @brief Max relative deviation of c from the exact product for a[i][j] = i + j, b_v[j] = j + v:
+ *        c_v[i] = i * S1 + S2 + v * (i * n + S1), S1 = sum j, S2 = sum j^2.
+ */
+double MaxRelativeError(const accum_t *c) {
+    const long double n = MATRIX_SIZE;
+    const long double s1 = n * (n - 1) / 2;
+    const long double s2 = n * (n - 1) * (2 * n - 1) / 6;
+    long double max_err = 0;
+    for (size_t i = 0; i < MATRIX_SIZE; i++) {
+        for (size_t v = 0; v < NVECTORS; v++) {
+            long double exact = i * s1 + s2 + v * (i * n + s1);
+            long double err = std::fabs(static_cast<long double>(c[i * NVECTORS + v]) - exact) / exact;
+            max_err = std::max(max_err, err);
+        }
     }
+    return static_cast<double>(max_err);
 }
 
 /**
  * @brief Сalculates the time spent on the parallel multiplication of the matrix
  *        by the vector.
+ * @param max_error Max relative error of the result against the exact product (last trial).
+ * @param path Matrix file: written on the first run, then mapped instead of building the matrix
+ *        in memory on every trial. nullptr - matrix in memory.
  * @param trials Number of trials to perform. Default is 20 trials.
  * @return minimum time (20 runs by default) spent on executing all trials of the parallel part
+ *         The buffers are allocated and initialized once; trials only repeat the product.
  */
-double TimeExecution(int trials = 20) {
-    long double *a, *b, *c;
+double TimeExecution(double &max_error, const char *path = nullptr, int trials = 20) {
+    matrix_t *a = nullptr;
+    accum_t *b, *c;
+    MatrixFile mf{};
+    Arena arena;
+
+    if (path != nullptr) {
+        auto start = std::chrono::high_resolution_clock::now();
+        if (matrix_file_open(&mf, path, MATRIX_SIZE, MATRIX_SIZE, sizeof(matrix_t), STORAGE_NAME, FillMatrixRows) != 0)
+            exit(13);
+        auto end = std::chrono::high_resolution_clock::now();
+        printf("Matrix file %s: %s in %.4lf seconds\n", path, mf.created ? "written" : "reused",
+               std::chrono::duration<double>(end - start).count());
+        a = static_cast<matrix_t *>(mf.data);
+    }
+
+    if (arena_init(&arena, TestDataBytes(path != nullptr), static_cast<ArenaPages>(ARENA_PAGES)) != 0) exit(13);
+    auto init_start = std::chrono::high_resolution_clock::now();
+    InitTestData(&arena, a, b, c, path != nullptr);
+    auto init_end = std::chrono::high_resolution_clock::now();
+    printf("Buffers: %zu MiB, %s pages, initialized in %.4lf seconds\n", arena.used >> 20,
+           arena_pages_name(arena.pages), std::chrono::duration<double>(init_end - init_start).count());
 
     double best_time = std::numeric_limits<double>::max();
 
     for (int i = 0; i < trials; ++i) {
-        InitTestData(a, b, c);
-
         auto start = std::chrono::high_resolution_clock::now();
 
-        ParallelMatrixVectorMultiply(a, b, c);
+        ParallelMatrixVectorMultiply(a, b, c, path != nullptr ? &mf : nullptr);
 
         auto end = std::chrono::high_resolution_clock::now();
         double elapsed = std::chrono::duration<double, std::milli>(end - start).count();
 
         best_time = (best_time < elapsed) ? best_time : elapsed;
-
-        free(a);
-        free(b);
-        free(c);
+        max_error = MaxRelativeError(c);
 
         printf("trial = %d\n", i);
     }
 
+    arena_release(&arena);
+    matrix_file_close(&mf);
     return best_time;
 }
 
-int main() {
+/**
+ * @param argv[1] Optional matrix file (see TimeExecution); lets the matrix exceed RAM.
+ */
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : nullptr;
     int m = MATRIX_SIZE;
     int n = MATRIX_SIZE;
-    printf("Matrix-vector product (c[m] = a[m, n] * b[n]; m = %d, n = %d)\n", m, n);
-    printf("Memory used: %" PRIu64 " MiB\n", ((m * n + m + n) * sizeof(long double)) >> 20);
+    int k = NVECTORS;
+    printf("Matrix-vector product (c[m] = a[m, n] * b[n]; m = %d, n = %d, vectors = %d)\n", m, n, k);
+    printf("Memory used: %" PRIu64 " MiB\n",
+           (static_cast<uint64_t>(m) * n * sizeof(matrix_t) + static_cast<uint64_t>(m + n) * k * sizeof(accum_t)) >> 20);
     printf("Number of threads: %d\n", NTHREADS);
+    printf("Matrix storage: %s\n", STORAGE_NAME);
+    printf("Threads: %s\n", THREAD_POOL ? (PIN_THREADS ? "pool, pinned" : "pool") : "created per call");
+    printf("Dispatch overhead: %.3lf us per call\n", DispatchOverhead());
 
-    printf("Best calculations took %.4lf seconds.\n", TimeExecution());
+    double max_error;
+    double best_time = TimeExecution(max_error, path);
+    printf("Best calculations took %.4lf ms.\n", best_time);
+    printf("Time per vector: %.4lf ms\n", best_time / k);
+    printf("Max relative error vs exact result: %.3e\n", max_error);
 }
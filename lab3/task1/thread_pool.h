@@ -0,0 +1,122 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * Threads started once and reused for every parallel call. A call is handed to the parked
+ * workers by advancing an epoch (std::atomic wait/notify, a futex on Linux), and the caller
+ * waits on a completion latch counted down by the workers. Both sides spin for a while
+ * before sleeping, so back-to-back calls never reach the kernel. The calling thread is
+ * worker 0; the others live in Container<std::jthread> (the THREAD_CONTAINER of task1).
+ */
+
+template <template <class...> class Container>
+class ThreadPool {
+public:
+    /**
+     * @param nthreads Workers, including the calling thread.
+     * @param pin Pin worker w to core w (modulo the number of cores), the caller to core 0.
+     */
+    ThreadPool(int nthreads, bool pin) : nthreads_(nthreads), workers_(nthreads - 1) {
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        // With more threads than cores a spinning thread holds the core the others need
+        spins_ = static_cast<unsigned>(nthreads) <= cores ? kSpins : 0;
+
+        int worker = 1;
+        for (std::jthread &thread : workers_) {
+            thread = std::jthread([this, worker] { Loop(worker); });
+            if (pin) Pin(thread.native_handle(), worker % cores);
+            worker++;
+        }
+        if (pin) Pin(pthread_self(), 0);
+    }
+
+    ~ThreadPool() {
+        stop_.store(true, std::memory_order_relaxed);
+        epoch_.fetch_add(1, std::memory_order_release);
+        epoch_.notify_all();
+        // The jthreads join when workers_ is destroyed.
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int Threads() const { return nthreads_; }
+
+    /**
+     * @brief Calls task(worker) on every worker (0 on the calling thread) and returns when
+     *        all calls have returned.
+     */
+    template <class Task>
+    void Run(const Task &task) {
+        task_ = &task;
+        call_ = [](const void *object, int worker) { (*static_cast<const Task *>(object))(worker); };
+        remaining_.store(nthreads_ - 1, std::memory_order_relaxed);
+        epoch_.fetch_add(1, std::memory_order_release);
+        epoch_.notify_all();
+
+        call_(task_, 0);
+
+        // Completion latch
+        WaitWhile(remaining_, [](int value) { return value != 0; });
+    }
+
+private:
+    // Checks of a spin wait before the thread sleeps.
+    static constexpr int kSpins = 1 << 14;
+
+    static void Pin(pthread_t thread, unsigned core) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        pthread_setaffinity_np(thread, sizeof(set), &set);
+    }
+
+    /**
+     * @brief Waits while pending(value) holds: spins_ checks, then sleeps on the atomic.
+     * @return The value that ended the wait.
+     */
+    template <class T, class Pending>
+    T WaitWhile(const std::atomic<T> &atomic, Pending pending) const {
+        T value = atomic.load(std::memory_order_acquire);
+        for (int spins = 0; spins < spins_ && pending(value); spins++) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+            value = atomic.load(std::memory_order_acquire);
+        }
+        while (pending(value)) {
+            atomic.wait(value, std::memory_order_acquire);
+            value = atomic.load(std::memory_order_acquire);
+        }
+        return value;
+    }
+
+    void Loop(int worker) {
+        uint32_t seen = 0;
+        while (true) {
+            seen = WaitWhile(epoch_, [seen](uint32_t value) { return value == seen; });
+            if (stop_.load(std::memory_order_relaxed)) return;
+            call_(task_, worker);
+            if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) remaining_.notify_one();
+        }
+    }
+
+    int nthreads_;
+    int spins_;
+    const void *task_ = nullptr;
+    void (*call_)(const void *, int) = nullptr;
+    std::atomic<bool> stop_{false};
+    alignas(64) std::atomic<uint32_t> epoch_{0};
+    alignas(64) std::atomic<int> remaining_{0};
+    // Last member: destroyed (joined) first, while the state above is still alive.
+    Container<std::jthread> workers_;
+};
+
+#endif  // THREAD_POOL_H
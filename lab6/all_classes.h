@@ -1,6 +1,247 @@
 #ifndef ALL_CLASSES_H
 #define ALL_CLASSES_H
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <omp.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * @brief Способ применения оператора Лапласа.
+ *  Dense   - плотная матрица A_ размера size_ * size_ (эталон, O(N^2) памяти);
+ *  Stencil - пятиточечный шаблон прямо на сетке Nx_ x Ny_ (O(N) памяти и работы).
+ */
+enum class OperatorType { Dense, Stencil };
+
+/**
+ * @brief Итерационный метод решения A * x = b.
+ *  Richardson - x -= tau_ * (A * x - b), исходный метод;
+ *  CG         - сопряжённые градиенты для -A (A отрицательно определена);
+ *  PCGJacobi  - CG с диагональным предобусловливателем;
+ *  PCGIC0     - CG с неполным разложением Холецкого без заполнения для пятиточечного шаблона;
+ *  Multigrid  - геометрический многосеточный метод (V- или W-циклы);
+ *  RedBlackSOR - последовательная верхняя релаксация на месте с красно-чёрным упорядочением.
+ */
+enum class SolverMethod { Richardson, CG, PCGJacobi, PCGIC0, Multigrid, RedBlackSOR };
+
+/**
+ * @brief Тип многосеточного цикла: V - один проход на грубую сетку, W - два.
+ */
+enum class MultigridCycle { V = 1, W = 2 };
+
+/**
+ * @brief Граничные значения правой части: температура линейно меняется вдоль каждой стороны
+ *        сетки Nx x Ny между температурами углов corners.
+ *        b хранит lanes наборов вперемежку (b[i * lanes + lane]); одиночный решатель - lanes = 1.
+ */
+inline void fill_boundary(double *b, int Nx, int Ny, const double corners[4], int lanes = 1, int lane = 0) {
+    auto at = [&](int row, int col) -> double & { return b[static_cast<size_t>(row * Nx + col) * lanes + lane]; };
+
+    // Верхняя граница (row=0)
+    for (int col = 0; col < Nx; ++col) {
+        double t = static_cast<double>(col) / (Nx - 1);
+        at(0, col) = corners[0] * (1 - t) + corners[1] * t;
+    }
+
+    // Нижняя граница (row=Ny-1)
+    for (int col = 0; col < Nx; ++col) {
+        double t = static_cast<double>(col) / (Nx - 1);
+        at(Ny - 1, col) = corners[3] * (1 - t) + corners[2] * t;
+    }
+
+    // Левая граница (col=0)
+    for (int row = 0; row < Ny; ++row) {
+        double t = static_cast<double>(row) / (Ny - 1);
+        at(row, 0) = corners[0] * (1 - t) + corners[3] * t;
+    }
+
+    // Правая граница (col=Nx-1)
+    for (int row = 0; row < Ny; ++row) {
+        double t = static_cast<double>(row) / (Ny - 1);
+        at(row, Nx - 1) = corners[1] * (1 - t) + corners[2] * t;
+    }
+}
+
+/**
+ * @brief Заголовок файла контрольной точки; за ним следуют nx * ny значений x в double.
+ *        iteration < 0 означает, что запись данных не завершена.
+ */
+struct CheckpointHeader {
+    char magic[8];
+    int32_t nx, ny;
+    int64_t iteration;
+};
+
+constexpr char kCheckpointMagic[8] = {'T', 'H', 'C', 'K', 'P', 'T', '1', '\0'};
+
+/**
+ * @brief Контрольная точка решения, записываемая через отображённый в память файл:
+ *        файл размечается один раз, каждая запись - это memcpy в отображение и msync(MS_ASYNC),
+ *        без системных вызовов write и без ожидания диска в итерационном цикле.
+ */
+class CheckpointFile {
+private:
+    int fd_ = -1;
+    void *map_ = nullptr;
+    size_t bytes_ = 0;
+
+public:
+    CheckpointFile(const CheckpointFile &) = delete;
+    CheckpointFile &operator=(const CheckpointFile &) = delete;
+
+    CheckpointFile(const std::string &path, int nx, int ny) {
+        bytes_ = sizeof(CheckpointHeader) + static_cast<size_t>(nx) * ny * sizeof(double);
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0 || ftruncate(fd_, static_cast<off_t>(bytes_)) != 0) {
+            std::cerr << "Error opening checkpoint file " << path << " for writing.\n";
+            return;
+        }
+        map_ = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (map_ == MAP_FAILED) {
+            std::cerr << "Error mapping checkpoint file " << path << ".\n";
+            map_ = nullptr;
+            return;
+        }
+        auto *header = static_cast<CheckpointHeader *>(map_);
+        std::memcpy(header->magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+        header->nx = nx;
+        header->ny = ny;
+        header->iteration = -1;
+    }
+
+    ~CheckpointFile() {
+        if (map_) {
+            msync(map_, bytes_, MS_SYNC);
+            munmap(map_, bytes_);
+        }
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool isOpen() const {
+        return map_ != nullptr;
+    }
+
+    void write(const double *x, long long iteration) {
+        if (!map_) return;
+        auto *header = static_cast<CheckpointHeader *>(map_);
+        header->iteration = -1;
+        std::memcpy(header + 1, x, bytes_ - sizeof(CheckpointHeader));
+        header->iteration = iteration;
+        msync(map_, bytes_, MS_ASYNC);
+    }
+};
+
+/**
+ * @brief Запись телеметрии решателя: номер итерации, относительная невязка и время от начала решения.
+ */
+struct TelemetryRecord {
+    int64_t iteration;
+    double residual;
+    double seconds;
+};
+
+/**
+ * @brief Кольцевой буфер телеметрии фиксированной ёмкости. Память выделяется заранее, record()
+ *        не делает системных вызовов и не выделяет память; при переполнении затираются самые
+ *        старые записи. Содержимое выгружается после решения в CSV или JSON.
+ */
+class Telemetry {
+private:
+    std::vector<TelemetryRecord> records_;
+    size_t count_ = 0; // сколько записей сделано всего, в буфере последние min(count_, capacity)
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+public:
+    explicit Telemetry(size_t capacity) : records_(std::max<size_t>(capacity, 1)) {}
+
+    void start() {
+        count_ = 0;
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    void record(int64_t iteration, double residual) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+        records_[count_ % records_.size()] = {iteration, residual, elapsed.count()};
+        count_++;
+    }
+
+    size_t size() const {
+        return std::min(count_, records_.size());
+    }
+
+    size_t dropped() const {
+        return count_ - size();
+    }
+
+    /**
+     * @brief k-я по времени запись из оставшихся в буфере (0 - самая старая).
+     */
+    const TelemetryRecord &operator[](size_t k) const {
+        return records_[(dropped() + k) % records_.size()];
+    }
+
+    /**
+     * @brief Ход решения из буфера: первая запись и первая после каждой тысячи итераций,
+     *        в виде "<unit> N: <quantity> = r". При переполнении буфера ранние строки теряются.
+     */
+    void print(const char *unit, const char *quantity) const {
+        if (dropped() > 0) {
+            std::cout << "Telemetry: first " << dropped() << " records dropped" << std::endl;
+        }
+        int64_t last = -1;
+        for (size_t k = 0; k < size(); ++k) {
+            const TelemetryRecord &rec = (*this)[k];
+            if (rec.iteration == 1 || last < 0 || rec.iteration / 1000 != last / 1000) {
+                std::cout << unit << " " << rec.iteration << ": " << quantity << " = " << rec.residual << std::endl;
+            }
+            last = rec.iteration;
+        }
+    }
+
+    /**
+     * @brief Пишет записи в path: JSON, если путь оканчивается на .json, иначе CSV.
+     */
+    bool write(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Error opening telemetry file " << path << " for writing.\n";
+            return false;
+        }
+        out.precision(17);
+        const bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        if (json) {
+            out << "{\"dropped\": " << dropped() << ", \"records\": [";
+            for (size_t k = 0; k < size(); ++k) {
+                const TelemetryRecord &rec = (*this)[k];
+                out << (k ? ",\n  " : "\n  ") << "{\"iteration\": " << rec.iteration << ", \"residual\": "
+                    << rec.residual << ", \"seconds\": " << rec.seconds << "}";
+            }
+            out << "\n]}\n";
+        } else {
+            out << "iteration,residual,seconds\n";
+            for (size_t k = 0; k < size(); ++k) {
+                const TelemetryRecord &rec = (*this)[k];
+                out << rec.iteration << "," << rec.residual << "," << rec.seconds << "\n";
+            }
+        }
+        return static_cast<bool>(out);
+    }
+};
+
 class ThermalSolver {
 private:
     int Nx_, Ny_;
@@ -8,17 +249,174 @@ private:
     double tau_;
     double epsilon_;
     int max_iter_;
+    OperatorType operator_ = OperatorType::Stencil;
+    int num_threads_ = 1;
+    SolverMethod method_ = SolverMethod::Richardson;
+    MultigridCycle mg_cycle_ = MultigridCycle::V;
+    int mg_pre_smooth_ = 2;
+    int mg_post_smooth_ = 2;
+    double omega_ = 0.0; // параметр SOR; 0 - оптимальный, вычисляется по Nx_ и Ny_
+    int tile_rows_ = 0;  // высота полосы при временной блокировке Ричардсона; 0 - без блокировки
+    int tile_depth_ = 4; // число шагов Ричардсона на одну загрузку полосы
+    int domains_ = 0;    // число подобластей-полос для Ричардсона с обменом ореолами; 0 - без разбиения
 
-    double *A_; // размер size_ * size_
+    double *A_ = nullptr; // размер size_ * size_, выделяется только для OperatorType::Dense
     double *b_; // размер size_
     double *x_; // размер size_
+    std::vector<double> zero_row_; // Nx_ нулей - соседняя строка за границей сетки
+    std::vector<float> zero_row_f_;
+    bool mixed_precision_ = false;
+
+    std::unique_ptr<CheckpointFile> checkpoint_;
+    int checkpoint_every_ = 0;
+    int last_checkpoint_ = 0;
+    int start_iter_ = 0; // итерация, с которой продолжается решение из контрольной точки
+
+    int check_every_ = 1; // невязка для проверки сходимости считается раз в check_every_ итераций
+    Telemetry telemetry_{1 << 16};
+    std::string telemetry_path_;
 
     const double corners_[4] = {10.0, 20.0, 30.0, 20.0};
 
+    /**
+     * @brief Оптимальный параметр SOR для пятиточечного шаблона: omega = 2 / (1 + sqrt(1 - rho^2)),
+     *        где rho = (cos(pi / (Nx_ + 1)) + cos(pi / (Ny_ + 1))) / 2 - спектральный радиус метода Якоби
+     *        при нулевых значениях за границей сетки.
+     */
+    double optimal_omega() const {
+        double rho = 0.5 * (std::cos(M_PI / (Nx_ + 1)) + std::cos(M_PI / (Ny_ + 1)));
+        return 2.0 / (1.0 + std::sqrt(1.0 - rho * rho));
+    }
+
+    /**
+     * @brief ||A * x_ - b_|| без промежуточного буфера.
+     */
+    double residual_norm() const {
+        double s = 0.0;
+#pragma omp parallel for num_threads(num_threads_) schedule(static) reduction(+:s)
+        for (int row = 0; row < Ny_; ++row) {
+            for (int col = 0; col < Nx_; ++col) {
+                double r = stencil_at(x_, row, col) - b_[idx(row, col)];
+                s += r * r;
+            }
+        }
+        return std::sqrt(s);
+    }
+
+    /**
+     * @brief Полушаг SOR по узлам одного цвета ((row + col) % 2 == color) прямо в x_.
+     *        Соседи узла - другого цвета, поэтому узлы одного цвета обновляются параллельно.
+     * @return Сумма квадратов невязок узлов цвета до их обновления (0 при Norm = false).
+     */
+    template <bool Norm = true>
+    double sor_half_sweep(int color, double omega) {
+        double s = 0.0;
+#pragma omp parallel for num_threads(num_threads_) schedule(static) reduction(+:s)
+        for (int row = 0; row < Ny_; ++row) {
+            for (int col = (row + color) % 2; col < Nx_; col += 2) {
+                int i = idx(row, col);
+                double r = stencil_at(x_, row, col) - b_[i];
+                if constexpr (Norm) s += r * r;
+                x_[i] += omega * r / 4.0;
+            }
+        }
+        return s;
+    }
+
+    /**
+     * @brief Красно-чёрный SOR. Для остановки используется сумма невязок, посчитанных по ходу
+     *        свипа (отдельного прохода по памяти нет), итоговая невязка считается точно.
+     * @return Число выполненных итераций.
+     */
+    int solve_sor(double norm_b, double &relative_residual) {
+        double omega = (omega_ > 0.0) ? omega_ : optimal_omega();
+        std::cout << "SOR omega = " << omega << std::endl;
+        int iter = 0;
+        bool check;
+
+        do {
+            check = is_check_iteration(iter + 1, max_iter_);
+            if (check) {
+                double s = sor_half_sweep(0, omega);
+                s += sor_half_sweep(1, omega);
+                relative_residual = std::sqrt(s) / norm_b;
+            } else {
+                sor_half_sweep<false>(0, omega);
+                sor_half_sweep<false>(1, omega);
+            }
+            iter++;
+            if (check) report_progress(iter, relative_residual);
+            maybe_checkpoint(iter, x_);
+
+            if (iter >= max_iter_) break;
+        } while (!check || relative_residual >= epsilon_);
+
+        relative_residual = residual_norm() / norm_b;
+        return iter;
+    }
+
+    /**
+     * @brief Уровень многосеточной иерархии. Оператор уровня - тот же шаблон с весами
+     *        scale_x и scale_y для соседей по строке и по столбцу: (h_0 / h)^2 по каждому
+     *        измерению (на сетках 2^k - 1 это 4^{-level}). Стороны огрубляются независимо,
+     *        см. GridTransfer.
+     */
+    struct GridLevel {
+        int nx, ny;
+        double scale_x, scale_y;
+        std::vector<double> x, b, r;
+    };
+
+    /**
+     * @brief Перенос между уровнями по одному измерению. Узлы сетки из n узлов делят отрезок
+     *        между нулевыми границами на n + 1 равных частей, грубая сетка - на nc + 1, nc = n / 2.
+     *        При нечётном n узел j грубой сетки совпадает с узлом 2j + 1 мелкой; при чётном
+     *        сетки не вложены (шаг грубой чуть меньше двух мелких), но граница у них общая,
+     *        поэтому грубая поправка верна и у последних узлов. Продолжение - линейная
+     *        интерполяция по грубым узлам и границам, сужение - транспонированное продолжение,
+     *        умноженное на ratio = h / H.
+     */
+    struct GridTransfer {
+        int n, nc;
+        double ratio;
+
+        explicit GridTransfer(int fine) : n(fine), nc(coarse_size(fine)), ratio((nc + 1.0) / (n + 1.0)) {}
+
+        static int coarse_size(int n) { return n / 2; }
+
+        /**
+         * @brief Узлы грубой сетки c[0], c[1] с весами w[0], w[1], из которых продолжается
+         *        узел i мелкой (индекс вне [0, nc) - граница с нулевым значением).
+         */
+        void prolongation(int i, int c[2], double w[2]) const {
+            const double t = (i + 1) * ratio - 1.0;
+            c[0] = static_cast<int>(std::floor(t));
+            c[1] = c[0] + 1;
+            w[1] = t - c[0];
+            w[0] = 1.0 - w[1];
+        }
+
+        /**
+         * @brief Веса w[0..4] узлов мелкой сетки first..first + 4, сужаемых в узел j грубой.
+         * @return first.
+         */
+        int restriction(int j, double w[5]) const {
+            const int first = static_cast<int>(std::floor(j / ratio)) - 1;
+            for (int k = 0; k < 5; ++k) {
+                const double t = (first + k + 1) * ratio - 1.0;
+                w[k] = std::max(0.0, 1.0 - std::abs(t - j)) * ratio;
+            }
+            return first;
+        }
+    };
+
     int idx(int row, int col) const { return row * Nx_ + col; }
 
     void initMatrix() {
-        std::memset(A_, 0, size_ * size_ * sizeof(double));
+        if (A_ == nullptr) {
+            A_ = new double[static_cast<size_t>(size_) * size_];
+        }
+        std::memset(A_, 0, static_cast<size_t>(size_) * size_ * sizeof(double));
 
         for (int row = 0; row < size_; ++row) {
             A_[row * size_ + row] = -4.0;
@@ -39,60 +437,774 @@ private:
 
     void initB() {
         std::memset(b_, 0, size_ * sizeof(double));
+        fill_boundary(b_, Nx_, Ny_, corners_);
+    }
+
+    double norm(const double *v) const {
+        double s = 0.0;
+#pragma omp parallel for num_threads(num_threads_) schedule(static) reduction(+:s)
+        for (int i = 0; i < size_; ++i) {
+            s += v[i] * v[i];
+        }
+        return std::sqrt(s);
+    }
 
-        // Верхняя граница (row=0)
-        for (int col = 0; col < Nx_; ++col) {
-            double t = static_cast<double>(col) / (Nx_ - 1);
-            b_[idx(0, col)] = corners_[0] * (1 - t) + corners_[1] * t;
+    template <typename T>
+    const T *zero_row() const {
+        if constexpr (std::is_same_v<T, float>) {
+            return zero_row_f_.data();
+        } else {
+            return zero_row_.data();
         }
+    }
 
-        // Нижняя граница (row=Ny_-1)
-        for (int col = 0; col < Nx_; ++col) {
-            double t = static_cast<double>(col) / (Nx_ - 1);
-            b_[idx(Ny_ - 1, col)] = corners_[3] * (1 - t) + corners_[2] * t;
+    /**
+     * @brief (A * x)[idx(row, col)] для пятиточечного шаблона: тот же оператор, что строит initMatrix().
+     *        Соседи за пределами сетки считаются нулевыми, как и отсутствующие элементы в строках A_.
+     */
+    template <typename T>
+    T stencil_at(const T *x, int row, int col) const {
+        int i = idx(row, col);
+        T sum = T(-4) * x[i];
+        if (col > 0) sum += x[i - 1];
+        if (col < Nx_ - 1) sum += x[i + 1];
+        if (row > 0) sum += x[i - Nx_];
+        if (row < Ny_ - 1) sum += x[i + Nx_];
+        return sum;
+    }
+
+    /**
+     * @brief res = A * x - y; при y == nullptr просто res = A * x.
+     */
+    void mul_mv_sub(double *res, const double *A, const double *x, const double *y) {
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+        for (int i = 0; i < size_; ++i) {
+            double sum = y ? -y[i] : 0.0;
+            for (int j = 0; j < size_; ++j) {
+                sum += A[static_cast<size_t>(i) * size_ + j] * x[j];
+            }
+            res[i] = sum;
         }
+    }
 
-        // Левая граница (col=0)
+    /**
+     * @brief res = A * x - y без хранения A; при y == nullptr просто res = A * x.
+     */
+    template <typename T>
+    void mul_stencil_sub(T *res, const T *x, const T *y) const {
+        const int n = Nx_;
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
         for (int row = 0; row < Ny_; ++row) {
-            double t = static_cast<double>(row) / (Ny_ - 1);
-            b_[idx(row, 0)] = corners_[0] * (1 - t) + corners_[3] * t;
+            const size_t i = static_cast<size_t>(row) * n;
+            const T *c = x + i;
+            const T *up = (row > 0) ? c - n : zero_row<T>();
+            const T *down = (row < Ny_ - 1) ? c + n : zero_row<T>();
+            const T *rhs = y ? y + i : zero_row<T>();
+            T *out = res + i;
+            if (n == 1) {
+                out[0] = T(-4) * c[0] + up[0] + down[0] - rhs[0];
+                continue;
+            }
+
+            out[0] = T(-4) * c[0] + c[1] + up[0] + down[0] - rhs[0];
+#pragma omp simd
+            for (int col = 1; col < n - 1; ++col) {
+                out[col] = T(-4) * c[col] + c[col - 1] + c[col + 1] + up[col] + down[col] - rhs[col];
+            }
+            out[n - 1] = T(-4) * c[n - 1] + c[n - 2] + up[n - 1] + down[n - 1] - rhs[n - 1];
         }
+    }
 
-        // Правая граница (col=Nx_-1)
+    /**
+     * @brief res = A * x - y выбранным оператором. Плотная матрица хранится только в double,
+     *        float-проходы смешанной точности всегда идут по шаблону - это тот же оператор.
+     */
+    template <typename T>
+    void apply_sub(T *res, const T *x, const T *y) {
+        if constexpr (std::is_same_v<T, double>) {
+            if (operator_ == OperatorType::Dense) {
+                mul_mv_sub(res, A_, x, y);
+                return;
+            }
+        }
+        mul_stencil_sub(res, x, y);
+    }
+
+    /**
+     * @brief Шаг Ричардсона для одной строки сетки: out = c - tau_ * (S(c) - b).
+     *        up/down - соседние строки (zero_row_ за границей сетки), крайние столбцы вынесены
+     *        из цикла, чтобы внутренний цикл был без ветвлений и векторизовался.
+     * @return Сумма квадратов невязок строки (0 при Norm = false).
+     */
+    template <bool Norm = true, typename T>
+    double richardson_row(T *out, const T *c, const T *up, const T *down, const T *b) const {
+        const int n = Nx_;
+        const T tau = static_cast<T>(tau_);
+        if (n == 1) {
+            T r = T(-4) * c[0] + up[0] + down[0] - b[0];
+            out[0] = c[0] - tau * r;
+            return Norm ? r * r : T(0);
+        }
+
+        T r0 = T(-4) * c[0] + c[1] + up[0] + down[0] - b[0];
+        T rn = T(-4) * c[n - 1] + c[n - 2] + up[n - 1] + down[n - 1] - b[n - 1];
+        T s = Norm ? r0 * r0 + rn * rn : T(0);
+        out[0] = c[0] - tau * r0;
+#pragma omp simd reduction(+:s)
+        for (int col = 1; col < n - 1; ++col) {
+            T r = T(-4) * c[col] + c[col - 1] + c[col + 1] + up[col] + down[col] - b[col];
+            if constexpr (Norm) s += r * r;
+            out[col] = c[col] - tau * r;
+        }
+        out[n - 1] = c[n - 1] - tau * rn;
+        return s;
+    }
+
+    /**
+     * @brief Один шаг Ричардсона за один проход по памяти: невязка r = A * x - b, её квадрат
+     *        в частичные суммы потоков и x_new = x - tau_ * r. Вместо трёх проходов
+     *        (mul_mv_sub, norm, next) - один, и одна редукция на итерацию.
+     *        При Norm = false невязка не накапливается - шаг между проверками сходимости.
+     * @return ||A * x - b||^2 для входного x (0 при Norm = false).
+     */
+    template <bool Norm = true, typename T>
+    double richardson_sweep(T *x_new, const T *x, const T *b) const {
+        double s = 0.0;
+        if constexpr (std::is_same_v<T, double>) {
+            if (operator_ == OperatorType::Dense) {
+#pragma omp parallel for num_threads(num_threads_) schedule(static) reduction(+:s)
+                for (int i = 0; i < size_; ++i) {
+                    const double *row = A_ + static_cast<size_t>(i) * size_;
+                    double r = -b[i];
+                    for (int j = 0; j < size_; ++j) {
+                        r += row[j] * x[j];
+                    }
+                    if constexpr (Norm) s += r * r;
+                    x_new[i] = x[i] - tau_ * r;
+                }
+                return s;
+            }
+        }
+
+#pragma omp parallel for num_threads(num_threads_) schedule(static) reduction(+:s)
         for (int row = 0; row < Ny_; ++row) {
-            double t = static_cast<double>(row) / (Ny_ - 1);
-            b_[idx(row, Nx_ - 1)] = corners_[1] * (1 - t) + corners_[2] * t;
+            const size_t i = static_cast<size_t>(row) * Nx_;
+            const T *up = (row > 0) ? x + i - Nx_ : zero_row<T>();
+            const T *down = (row < Ny_ - 1) ? x + i + Nx_ : zero_row<T>();
+            s += richardson_row<Norm>(x_new + i, x + i, up, down, b + i);
         }
+        return s;
     }
 
-    double norm(const double *v) const {
+    /**
+     * @brief Скалярное произведение; частичные суммы всегда в double, в том числе для float-векторов.
+     */
+    template <typename T>
+    double dot(const T *u, const T *v) const {
         double s = 0.0;
+#pragma omp parallel for num_threads(num_threads_) schedule(static) reduction(+:s)
         for (int i = 0; i < size_; ++i) {
-            s += v[i] * v[i];
+            s += static_cast<double>(u[i]) * v[i];
         }
-        return std::sqrt(s);
+        return s;
     }
 
-    void mul_mv_sub(double *res, const double *A, const double *x, const double *y) {
-        for (int i = 0; i < size_; ++i) {
-            double sum = -y[i];
-            for (int j = 0; j < size_; ++j) {
-                sum += A[i * size_ + j] * x[j];
+    /**
+     * @brief Диагональ IC(0)-разложения -A ~ (D + L) D^{-1} (D + L^T), где L - строго нижняя часть -A.
+     *        У пятиточечного шаблона нет заполнения, поэтому d_i = 4 - 1/d_{i-1} - 1/d_{i-Nx_}.
+     */
+    template <typename T>
+    void init_ic0(T *d) const {
+        for (int row = 0; row < Ny_; ++row) {
+            for (int col = 0; col < Nx_; ++col) {
+                int i = idx(row, col);
+                T di = 4;
+                if (col > 0) di -= T(1) / d[i - 1];
+                if (row > 0) di -= T(1) / d[i - Nx_];
+                d[i] = di;
             }
-            res[i] = sum;
         }
     }
 
-    void next(double *x, const double *delta) {
-        for (int i = 0; i < size_; ++i) {
-            x[i] -= tau_ * delta[i];
+    /**
+     * @brief z = M^{-1} * r для выбранного предобусловливателя -A.
+     *        Прямой и обратный ход IC(0) последовательны по построению, остальное - в num_threads_ потоков.
+     */
+    template <typename T>
+    void precondition(T *z, const T *r, const T *ic_diag) const {
+        if (method_ == SolverMethod::PCGIC0) {
+            // (D + L) y = r
+            for (int row = 0; row < Ny_; ++row) {
+                for (int col = 0; col < Nx_; ++col) {
+                    int i = idx(row, col);
+                    T s = r[i];
+                    if (col > 0) s += z[i - 1];
+                    if (row > 0) s += z[i - Nx_];
+                    z[i] = s / ic_diag[i];
+                }
+            }
+            // (D + L^T) z = D y
+            for (int row = Ny_ - 1; row >= 0; --row) {
+                for (int col = Nx_ - 1; col >= 0; --col) {
+                    int i = idx(row, col);
+                    T s = 0;
+                    if (col < Nx_ - 1) s += z[i + 1];
+                    if (row < Ny_ - 1) s += z[i + Nx_];
+                    z[i] += s / ic_diag[i];
+                }
+            }
+        } else if (method_ == SolverMethod::PCGJacobi) {
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+            for (int i = 0; i < size_; ++i) {
+                z[i] = r[i] / T(4); // диагональ -A, в том числе плотной матрицы из initMatrix()
+            }
+        } else {
+            std::memcpy(z, r, size_ * sizeof(T));
+        }
+    }
+
+    /**
+     * @brief Итерация с проверкой сходимости: каждая check_every_-я и последняя допустимая.
+     */
+    bool is_check_iteration(int iter, int max_iter) const {
+        return iter % check_every_ == 0 || iter >= max_iter;
+    }
+
+    /**
+     * @brief Заносит невязку итерации в кольцевой буфер телеметрии; в горячем цикле нет вывода.
+     */
+    void report_progress(int iter, double relative_residual) {
+        telemetry_.record(iter, relative_residual);
+    }
+
+    bool checkpoint_due(int iter) const {
+        return checkpoint_ && iter - last_checkpoint_ >= checkpoint_every_;
+    }
+
+    /**
+     * @brief Записывает x в контрольную точку, если с прошлой записи прошло не меньше
+     *        checkpoint_every_ итераций (блочные методы продвигаются сразу на несколько).
+     */
+    void maybe_checkpoint(int iter, const double *x) {
+        if (!checkpoint_due(iter)) return;
+        checkpoint_->write(x, start_iter_ + iter);
+        last_checkpoint_ = iter;
+    }
+
+    /**
+     * @brief depth шагов Ричардсона за один проход по памяти (временная блокировка, трапециевидные тайлы).
+     *        Сетка режется на полосы по tile_rows_ строк; поток загружает полосу вместе с depth
+     *        строками ореола с каждой стороны в локальный буфер (он остаётся в L2) и делает на нём
+     *        depth шагов, с каждым шагом сужая верную область на строку. В x_next записываются
+     *        только собственные строки полосы, ореол пересчитывается соседними полосами.
+     * @param step_sums [out] ||A * x_k - b||^2 для каждого из depth шагов, собранные по собственным строкам полос.
+     * @param buffers По два буфера на поток, каждый на (tile_rows_ + 2 * depth) * Nx_ элементов.
+     */
+    void richardson_blocked(double *x_next, const double *x, int depth, double *step_sums,
+                            std::vector<std::vector<double>> &buffers) const {
+        const int tiles = (Ny_ + tile_rows_ - 1) / tile_rows_;
+        std::fill(step_sums, step_sums + depth, 0.0);
+
+#pragma omp parallel num_threads(num_threads_)
+        {
+            double *cur = buffers[2 * omp_get_thread_num()].data();
+            double *nxt = buffers[2 * omp_get_thread_num() + 1].data();
+            std::vector<double> local_sums(depth, 0.0);
+
+#pragma omp for schedule(static)
+            for (int t = 0; t < tiles; ++t) {
+                const int r0 = t * tile_rows_;
+                const int r1 = std::min(Ny_, r0 + tile_rows_);
+                const int lo = std::max(0, r0 - depth);
+                const int hi = std::min(Ny_, r1 + depth);
+                std::memcpy(cur, x + static_cast<size_t>(lo) * Nx_, static_cast<size_t>(hi - lo) * Nx_ * sizeof(double));
+
+                for (int step = 0; step < depth; ++step) {
+                    const int clo = (lo == 0) ? 0 : lo + step + 1;
+                    const int chi = (hi == Ny_) ? Ny_ : hi - step - 1;
+                    for (int row = clo; row < chi; ++row) {
+                        const double *c = cur + static_cast<size_t>(row - lo) * Nx_;
+                        const double *up = (row > 0) ? c - Nx_ : zero_row_.data();
+                        const double *down = (row < Ny_ - 1) ? c + Nx_ : zero_row_.data();
+                        double s = richardson_row(nxt + static_cast<size_t>(row - lo) * Nx_, c, up, down,
+                                                  b_ + static_cast<size_t>(row) * Nx_);
+                        if (row >= r0 && row < r1) local_sums[step] += s;
+                    }
+                    std::swap(cur, nxt);
+                }
+
+                std::memcpy(x_next + static_cast<size_t>(r0) * Nx_, cur + static_cast<size_t>(r0 - lo) * Nx_,
+                            static_cast<size_t>(r1 - r0) * Nx_ * sizeof(double));
+            }
+
+#pragma omp critical
+            for (int step = 0; step < depth; ++step) {
+                step_sums[step] += local_sums[step];
+            }
         }
     }
 
+    /**
+     * @brief Метод Ричардсона: x -= tau_ * (A * x - b) до ||A * x - b|| / ||b|| < epsilon_.
+     *        Для шаблонного оператора при tile_rows_ > 0 шаги идут блоками по tile_depth_,
+     *        невязки всех шагов блока проверяются после него, так что сверх нужного может
+     *        быть сделано до tile_depth_ - 1 шагов.
+     * @return Число выполненных итераций.
+     */
+    int solve_richardson(double norm_b, double &relative_residual) {
+        if (domains_ > 1 && operator_ == OperatorType::Stencil) {
+            return solve_decomposed(norm_b, relative_residual);
+        }
+
+        if (tile_rows_ > 0 && operator_ == OperatorType::Stencil) {
+            double *x_next = new double[size_];
+            int iter = 0;
+            const size_t buffer_size = static_cast<size_t>(tile_rows_ + 2 * tile_depth_) * Nx_;
+            std::vector<std::vector<double>> buffers(2 * num_threads_, std::vector<double>(buffer_size));
+            std::vector<double> step_sums(tile_depth_);
+            bool converged = false;
+
+            while (!converged && iter < max_iter_) {
+                const int depth = std::min(tile_depth_, max_iter_ - iter);
+                richardson_blocked(x_next, x_, depth, step_sums.data(), buffers);
+                std::swap(x_, x_next);
+                for (int step = 0; step < depth; ++step) {
+                    relative_residual = std::sqrt(step_sums[step]) / norm_b;
+                    iter++;
+                    if (is_check_iteration(iter, max_iter_)) report_progress(iter, relative_residual);
+                    if (relative_residual < epsilon_) {
+                        converged = true;
+                        break;
+                    }
+                }
+                maybe_checkpoint(iter, x_);
+            }
+            delete[] x_next;
+            return iter;
+        }
+
+        return richardson(x_, b_, norm_b, epsilon_, max_iter_, relative_residual, 0);
+    }
+
+    /**
+     * @brief Ричардсон с разбиением сетки на domains_ полос строк. Каждый поток-исполнитель
+     *        сам выделяет и заполняет свою полосу с двумя строками-призраками (первое касание
+     *        оставляет её в памяти своего NUMA-узла), делает шаг только по ней, а затем забирает
+     *        граничные строки соседей в свои призраки. Частичные суммы невязки и указатели на
+     *        текущие буферы публикуются в двух чередующихся наборах слотов, поэтому на итерацию
+     *        нужен один барьер (и ещё один на итерациях с контрольной точкой); итог все потоки
+     *        суммируют в одном порядке и одинаково решают, остановиться ли.
+     * @return Число выполненных итераций.
+     */
+    int solve_decomposed(double norm_b, double &relative_residual) {
+        const int P = std::min(domains_, Ny_);
+        const int rows_per_domain = Ny_ / P;
+        std::vector<double> partial(2 * P);
+        std::vector<const double *> published(2 * P);
+        int iterations = 0;
+
+#pragma omp parallel num_threads(P)
+        {
+            const int p = omp_get_thread_num();
+            const int r0 = p * rows_per_domain;
+            const int r1 = (p == P - 1) ? Ny_ : r0 + rows_per_domain;
+            const int rows = r1 - r0;
+            const size_t row_bytes = Nx_ * sizeof(double);
+
+            // Строка 0 и строка rows + 1 - призраки с соседних полос.
+            std::vector<double> cur_buf(static_cast<size_t>(rows + 2) * Nx_);
+            std::vector<double> nxt_buf(static_cast<size_t>(rows + 2) * Nx_);
+            std::vector<double> b_local(b_ + static_cast<size_t>(r0) * Nx_, b_ + static_cast<size_t>(r1) * Nx_);
+            double *cur = cur_buf.data();
+            double *nxt = nxt_buf.data();
+            std::memcpy(cur + Nx_, x_ + static_cast<size_t>(r0) * Nx_, rows * row_bytes);
+
+            // Верхний сосед владеет rows_per_domain строками: его последняя строка - с индексом
+            // rows_per_domain в его буфере, первая строка нижнего соседа - с индексом 1.
+            auto exchange = [&](int slot) {
+                if (p > 0) {
+                    std::memcpy(cur, published[slot * P + p - 1] + static_cast<size_t>(rows_per_domain) * Nx_,
+                                row_bytes);
+                }
+                if (p < P - 1) {
+                    std::memcpy(cur + static_cast<size_t>(rows + 1) * Nx_, published[slot * P + p + 1] + Nx_,
+                                row_bytes);
+                }
+            };
+
+            published[P + p] = cur;
+#pragma omp barrier
+            exchange(1);
+
+            int iter = 0;
+            double rel = 0.0;
+            while (true) {
+                const int slot = iter % 2;
+                const bool check = is_check_iteration(iter + 1, max_iter_);
+                double s = 0.0;
+                for (int lr = 1; lr <= rows; ++lr) {
+                    const int row = r0 + lr - 1;
+                    const double *c = cur + static_cast<size_t>(lr) * Nx_;
+                    const double *up = (row > 0) ? c - Nx_ : zero_row_.data();
+                    const double *down = (row < Ny_ - 1) ? c + Nx_ : zero_row_.data();
+                    double *out = nxt + static_cast<size_t>(lr) * Nx_;
+                    const double *rhs = b_local.data() + static_cast<size_t>(lr - 1) * Nx_;
+                    s += check ? richardson_row(out, c, up, down, rhs) : richardson_row<false>(out, c, up, down, rhs);
+                }
+                std::swap(cur, nxt);
+                partial[slot * P + p] = s;
+                published[slot * P + p] = cur;
+#pragma omp barrier
+                iter++;
+                if (check) {
+                    double total = 0.0;
+                    for (int q = 0; q < P; ++q) {
+                        total += partial[slot * P + q];
+                    }
+                    rel = std::sqrt(total) / norm_b;
+                    if (p == 0) report_progress(iter, rel);
+                    if (checkpoint_due(iter)) {
+                        // Контрольная точка пишется из x_: каждый поток кладёт туда свою полосу.
+                        std::memcpy(x_ + static_cast<size_t>(r0) * Nx_, cur + Nx_, rows * row_bytes);
+#pragma omp barrier
+                        if (p == 0) maybe_checkpoint(iter, x_);
+                    }
+                    if (rel < epsilon_) break;
+                }
+                if (iter >= max_iter_) break;
+                exchange(slot);
+            }
+
+            std::memcpy(x_ + static_cast<size_t>(r0) * Nx_, cur + Nx_, rows * row_bytes);
+            if (p == 0) {
+                iterations = iter;
+                relative_residual = rel;
+            }
+        }
+
+        return iterations;
+    }
+
+    /**
+     * @brief Метод Ричардсона для A * x = b в точности T; x обменивается с рабочим буфером.
+     * @param iter_base Номер итерации, с которого ведётся отчёт о ходе решения.
+     * @return Число выполненных итераций.
+     */
+    template <typename T>
+    int richardson(T *&x, const T *b, double norm_b, double tol, int max_iter, double &relative_residual,
+                   int iter_base) {
+        T *x_next = new T[size_];
+        int iter = 0;
+        bool check;
+
+        do {
+            check = is_check_iteration(iter + 1, max_iter);
+            if (check) {
+                relative_residual = std::sqrt(richardson_sweep(x_next, x, b)) / norm_b;
+            } else {
+                richardson_sweep<false>(x_next, x, b);
+            }
+            std::swap(x, x_next);
+            iter++;
+            if (check) report_progress(iter_base + iter, relative_residual);
+            if constexpr (std::is_same_v<T, double>) {
+                maybe_checkpoint(iter, x);
+            }
+
+            if (iter >= max_iter) break;
+        } while (!check || relative_residual >= tol);
+
+        delete[] x_next;
+        return iter;
+    }
+
+    /**
+     * @brief (Предобусловленный) метод сопряжённых градиентов для -A * x = -b в точности T.
+     *        r = A * x - b совпадает с невязкой Ричардсона, поэтому критерий остановки тот же.
+     * @param iter_base Номер итерации, с которого ведётся отчёт о ходе решения.
+     * @return Число выполненных итераций.
+     */
+    template <typename T>
+    int cg(T *x, const T *b, double norm_b, double tol, int max_iter, double &relative_residual, int iter_base) {
+        T *r = new T[size_];
+        T *z = new T[size_];
+        T *p = new T[size_];
+        T *q = new T[size_];
+        T *ic_diag = nullptr;
+
+        if (method_ == SolverMethod::PCGIC0) {
+            ic_diag = new T[size_];
+            init_ic0(ic_diag);
+        }
+
+        apply_sub(r, x, b);
+        precondition(z, r, ic_diag);
+        std::memcpy(p, z, size_ * sizeof(T));
+        double rz = dot(r, z);
+        relative_residual = std::sqrt(dot(r, r)) / norm_b;
+        int iter = 0;
+
+        while (relative_residual >= tol && iter < max_iter) {
+            apply_sub(q, p, static_cast<const T *>(nullptr));
+            const T alpha = static_cast<T>(-rz / dot(p, q));
+
+            const bool check = is_check_iteration(iter + 1, max_iter);
+            double rr = 0.0;
+#pragma omp parallel for num_threads(num_threads_) schedule(static) reduction(+:rr)
+            for (int i = 0; i < size_; ++i) {
+                x[i] += alpha * p[i];
+                r[i] += alpha * q[i];
+                if (check) rr += static_cast<double>(r[i]) * r[i];
+            }
+            iter++;
+            if (check) {
+                relative_residual = std::sqrt(rr) / norm_b;
+                report_progress(iter_base + iter, relative_residual);
+            }
+            if constexpr (std::is_same_v<T, double>) {
+                maybe_checkpoint(iter, x);
+            }
+
+            precondition(z, r, ic_diag);
+            double rz_next = dot(r, z);
+            const T beta = static_cast<T>(rz_next / rz);
+            rz = rz_next;
+
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+            for (int i = 0; i < size_; ++i) {
+                p[i] = z[i] + beta * p[i];
+            }
+        }
+
+        delete[] r;
+        delete[] z;
+        delete[] p;
+        delete[] q;
+        delete[] ic_diag;
+        return iter;
+    }
+
+    /**
+     * @brief Смешанная точность с итерационным уточнением. Внешний цикл в double:
+     *        r = A * x_ - b_, затем внутренним методом в float решается A * d = r и x_ -= d.
+     *        Внутренние итерации идут по вдвое меньшему объёму данных и вдвое более широким
+     *        SIMD-регистрам, а точность epsilon_ достигается по невязке в double.
+     *        Внутренний решатель - CG/PCG для методов семейства CG и Ричардсон для richardson.
+     * @return Суммарное число внутренних итераций.
+     */
+    int solve_mixed(double norm_b, double &relative_residual) {
+        double *r = new double[size_];
+        float *rf = new float[size_];
+        float *df = new float[size_];
+        int iter = 0;
+
+        apply_sub(r, x_, b_);
+        double norm_r = norm(r);
+        relative_residual = norm_r / norm_b;
+
+        while (relative_residual >= epsilon_ && iter < max_iter_) {
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+            for (int i = 0; i < size_; ++i) {
+                rf[i] = static_cast<float>(r[i]);
+                df[i] = 0.0f;
+            }
+
+            // Внутреннее решение не точнее, чем позволяет float, и не точнее, чем нужно для epsilon_.
+            // У Ричардсона шаг tau_ * r перестаёт менять d в float раньше, поэтому порог у него грубее.
+            const double float_tol = (method_ == SolverMethod::Richardson) ? 1e-3 : 1e-5;
+            double inner_tol = std::max(float_tol, 0.5 * epsilon_ * norm_b / norm_r);
+            double inner_residual;
+            double norm_rf = std::sqrt(dot(rf, rf));
+            int inner;
+            if (method_ == SolverMethod::Richardson) {
+                inner = richardson(df, rf, norm_rf, inner_tol, max_iter_ - iter, inner_residual, iter);
+            } else {
+                inner = cg(df, rf, norm_rf, inner_tol, max_iter_ - iter, inner_residual, iter);
+            }
+            iter += inner;
+
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+            for (int i = 0; i < size_; ++i) {
+                x_[i] -= df[i];
+            }
+
+            apply_sub(r, x_, b_);
+            norm_r = norm(r);
+            relative_residual = norm_r / norm_b;
+            // Невязка в double после уточнения - под номером последней внутренней итерации.
+            report_progress(iter, relative_residual);
+            maybe_checkpoint(iter, x_);
+        }
+
+        delete[] r;
+        delete[] rf;
+        delete[] df;
+        return iter;
+    }
+
+    /**
+     * @brief r = b - S(x) на сетке nx x ny с весами уровня и нулевыми значениями за её пределами.
+     * @return ||r||^2.
+     */
+    double level_residual(GridLevel &lv) const {
+        const int nx = lv.nx, ny = lv.ny;
+        const double *x = lv.x.data();
+        const double *b = lv.b.data();
+        double *r = lv.r.data();
+        double s = 0.0;
+#pragma omp parallel for num_threads(num_threads_) schedule(static) reduction(+:s)
+        for (int row = 0; row < ny; ++row) {
+            for (int col = 0; col < nx; ++col) {
+                int i = row * nx + col;
+                double ax = -2.0 * x[i];
+                if (col > 0) ax += x[i - 1];
+                if (col < nx - 1) ax += x[i + 1];
+                double ay = -2.0 * x[i];
+                if (row > 0) ay += x[i - nx];
+                if (row < ny - 1) ay += x[i + nx];
+                r[i] = b[i] - (lv.scale_x * ax + lv.scale_y * ay);
+                s += r[i] * r[i];
+            }
+        }
+        return s;
+    }
+
+    /**
+     * @brief Взвешенный Якоби (omega = 0.8): x += omega * r / diag, diag = -2 * (scale_x + scale_y).
+     *        Порядок обхода не важен, поэтому свип параллелится без раскраски.
+     */
+    void smooth(GridLevel &lv, int sweeps) const {
+        const double omega = 0.8;
+        const double inv_diag = -1.0 / (2.0 * (lv.scale_x + lv.scale_y));
+        for (int k = 0; k < sweeps; ++k) {
+            level_residual(lv);
+            const int n = lv.nx * lv.ny;
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+            for (int i = 0; i < n; ++i) {
+                lv.x[i] += omega * inv_diag * lv.r[i];
+            }
+        }
+    }
+
+    /**
+     * @brief Полновесовое сужение невязки мелкого уровня в правую часть грубого
+     *        (на вложенных сетках - веса 1/16 [1 2 1; 2 4 2; 1 2 1]), см. GridTransfer.
+     */
+    void restrict_residual(const GridLevel &fine, GridLevel &coarse) const {
+        const int fnx = fine.nx, fny = fine.ny;
+        const GridTransfer tx(fnx), ty(fny);
+        const double *r = fine.r.data();
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+        for (int row = 0; row < coarse.ny; ++row) {
+            double wr[5];
+            const int fr = ty.restriction(row, wr);
+            for (int col = 0; col < coarse.nx; ++col) {
+                double wc[5];
+                const int fc = tx.restriction(col, wc);
+                double s = 0.0;
+                for (int dr = 0; dr < 5; ++dr) {
+                    const int rr = fr + dr;
+                    if (rr < 0 || rr >= fny || wr[dr] == 0.0) continue;
+                    for (int dc = 0; dc < 5; ++dc) {
+                        const int cc = fc + dc;
+                        if (cc < 0 || cc >= fnx || wc[dc] == 0.0) continue;
+                        s += wr[dr] * wc[dc] * r[rr * fnx + cc];
+                    }
+                }
+                coarse.b[row * coarse.nx + col] = s;
+            }
+        }
+    }
+
+    /**
+     * @brief Билинейное продолжение поправки с грубого уровня: fine.x += P * coarse.x,
+     *        за пределами грубой сетки поправка нулевая.
+     */
+    void prolongate_add(const GridLevel &coarse, GridLevel &fine) const {
+        const int cnx = coarse.nx, cny = coarse.ny;
+        const GridTransfer tx(fine.nx), ty(fine.ny);
+        const double *e = coarse.x.data();
+        auto at = [&](int row, int col) {
+            return (row < 0 || col < 0 || row >= cny || col >= cnx) ? 0.0 : e[row * cnx + col];
+        };
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+        for (int row = 0; row < fine.ny; ++row) {
+            int cr[2];
+            double wr[2];
+            ty.prolongation(row, cr, wr);
+            for (int col = 0; col < fine.nx; ++col) {
+                int cc[2];
+                double wc[2];
+                tx.prolongation(col, cc, wc);
+                fine.x[row * fine.nx + col] += wr[0] * (wc[0] * at(cr[0], cc[0]) + wc[1] * at(cr[0], cc[1])) +
+                                               wr[1] * (wc[0] * at(cr[1], cc[0]) + wc[1] * at(cr[1], cc[1]));
+            }
+        }
+    }
+
+    void mg_cycle(std::vector<GridLevel> &levels, size_t l) const {
+        GridLevel &lv = levels[l];
+        if (l + 1 == levels.size()) {
+            // Самая грубая сетка - несколько узлов по стороне, сглаживаем до сходимости.
+            smooth(lv, 8 * (lv.nx + lv.ny));
+            return;
+        }
+
+        smooth(lv, mg_pre_smooth_);
+        level_residual(lv);
+
+        GridLevel &coarse = levels[l + 1];
+        restrict_residual(lv, coarse);
+        std::fill(coarse.x.begin(), coarse.x.end(), 0.0);
+        for (int k = 0; k < static_cast<int>(mg_cycle_); ++k) {
+            mg_cycle(levels, l + 1);
+        }
+
+        prolongate_add(coarse, lv);
+        smooth(lv, mg_post_smooth_);
+    }
+
+    /**
+     * @brief Многосеточный метод: циклы до ||A * x - b|| / ||b|| < epsilon_, не более max_iter_ циклов.
+     * @return Число выполненных циклов.
+     */
+    int solve_multigrid(double norm_b, double &relative_residual) {
+        std::vector<GridLevel> levels;
+        int nx = Nx_, ny = Ny_;
+        while (true) {
+            size_t n = static_cast<size_t>(nx) * ny;
+            const double hx = (nx + 1.0) / (Nx_ + 1.0), hy = (ny + 1.0) / (Ny_ + 1.0);
+            levels.push_back({nx, ny, hx * hx, hy * hy, std::vector<double>(n), std::vector<double>(n),
+                              std::vector<double>(n)});
+            if (nx < 3 || ny < 3) break;
+            nx = GridTransfer::coarse_size(nx);
+            ny = GridTransfer::coarse_size(ny);
+        }
+
+        GridLevel &fine = levels.front();
+        std::memcpy(fine.x.data(), x_, size_ * sizeof(double));
+        std::memcpy(fine.b.data(), b_, size_ * sizeof(double));
+
+        relative_residual = std::sqrt(level_residual(fine)) / norm_b;
+        int cycles = 0;
+        while (relative_residual >= epsilon_ && cycles < max_iter_) {
+            mg_cycle(levels, 0);
+            cycles++;
+            if (is_check_iteration(cycles, max_iter_)) {
+                relative_residual = std::sqrt(level_residual(fine)) / norm_b;
+                report_progress(cycles, relative_residual);
+            }
+            maybe_checkpoint(cycles, fine.x.data());
+        }
+
+        std::memcpy(x_, fine.x.data(), size_ * sizeof(double));
+        return cycles;
+    }
+
 public:
     ThermalSolver(int Nx, int Ny, double epsilon, int max_iter, double tau)
-        : Nx_(Nx), Ny_(Ny), size_(Nx * Ny), epsilon_(epsilon), max_iter_(max_iter), tau_(tau) {
-        A_ = new double[size_ * size_];
+        : Nx_(Nx), Ny_(Ny), size_(Nx * Ny), tau_(tau), epsilon_(epsilon), max_iter_(max_iter), zero_row_(Nx),
+          zero_row_f_(Nx) {
         b_ = new double[size_];
         x_ = new double[size_];
         std::memset(x_, 0, size_ * sizeof(double));
@@ -104,41 +1216,503 @@ public:
         delete[] x_;
     }
 
+    void setOperator(OperatorType op) {
+        operator_ = op;
+    }
+
+    /**
+     * @brief Число потоков OpenMP для всех проходов по сетке; 0 - все доступные ядра.
+     */
+    void setThreads(int num_threads) {
+        num_threads_ = (num_threads > 0) ? num_threads : omp_get_max_threads();
+    }
+
+    void setMethod(SolverMethod method) {
+        method_ = method;
+    }
+
+    /**
+     * @brief Параметры многосеточного метода: тип цикла и число сглаживаний до и после грубой поправки.
+     */
+    void setMultigrid(MultigridCycle cycle, int pre_smooth, int post_smooth) {
+        mg_cycle_ = cycle;
+        mg_pre_smooth_ = pre_smooth;
+        mg_post_smooth_ = post_smooth;
+    }
+
+    /**
+     * @brief Параметр релаксации для RedBlackSOR; 0 - оптимальный для данной сетки.
+     */
+    void setOmega(double omega) {
+        omega_ = omega;
+    }
+
+    /**
+     * @brief Временная блокировка метода Ричардсона: полосы по tile_rows строк, depth шагов
+     *        на одну загрузку полосы. tile_rows = 0 отключает блокировку.
+     */
+    void setTemporalBlocking(int tile_rows, int depth) {
+        tile_rows_ = tile_rows;
+        tile_depth_ = std::max(1, depth);
+    }
+
+    /**
+     * @brief Внутренние итерации в float с уточнением в double (для richardson и методов CG).
+     */
+    void setMixedPrecision(bool enabled) {
+        mixed_precision_ = enabled;
+    }
+
+    /**
+     * @brief Начальное приближение вместо x_ = 0. Решение с сетки nx x ny другого размера
+     *        билинейно переносится на текущую сетку (узлы обеих сеток равномерно покрывают
+     *        один и тот же квадрат), номер итерации при этом не сохраняется.
+     * @param iteration Номер итерации, на которой было получено x (для продолжения из контрольной точки).
+     */
+    void setInitialGuess(const std::vector<double> &x, int nx, int ny, int iteration) {
+        if (nx == Nx_ && ny == Ny_) {
+            std::memcpy(x_, x.data(), size_ * sizeof(double));
+            start_iter_ = iteration;
+            return;
+        }
+
+        auto coord = [](int i, int n_to, int n_from, int &lo, double &w) {
+            double pos = (n_to > 1 && n_from > 1) ? static_cast<double>(i) * (n_from - 1) / (n_to - 1) : 0.0;
+            lo = std::min(static_cast<int>(pos), std::max(n_from - 2, 0));
+            w = (n_from > 1) ? pos - lo : 0.0;
+        };
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+        for (int row = 0; row < Ny_; ++row) {
+            int r0;
+            double wr;
+            coord(row, Ny_, ny, r0, wr);
+            int r1 = std::min(r0 + 1, ny - 1);
+            for (int col = 0; col < Nx_; ++col) {
+                int c0;
+                double wc;
+                coord(col, Nx_, nx, c0, wc);
+                int c1 = std::min(c0 + 1, nx - 1);
+                x_[idx(row, col)] = (1 - wr) * ((1 - wc) * x[r0 * nx + c0] + wc * x[r0 * nx + c1]) +
+                                    wr * ((1 - wc) * x[r1 * nx + c0] + wc * x[r1 * nx + c1]);
+            }
+        }
+        start_iter_ = 0;
+    }
+
+    /**
+     * @brief Каждые every итераций (циклов) x_ и номер итерации пишутся в файл path.
+     */
+    void setCheckpoint(const std::string &path, int every) {
+        checkpoint_every_ = every;
+        checkpoint_.reset();
+        if (every > 0) {
+            checkpoint_ = std::make_unique<CheckpointFile>(path, Nx_, Ny_);
+            if (!checkpoint_->isOpen()) checkpoint_.reset();
+        }
+    }
+
+    /**
+     * @brief Разбиение сетки на domains полос для Ричардсона, по потоку на полосу; 0 или 1 - без разбиения.
+     */
+    void setDomains(int domains) {
+        domains_ = domains;
+    }
+
+    /**
+     * @brief Проверять сходимость (считать норму невязки) раз в every итераций; между проверками
+     *        шаги идут без редукции. Метод может сделать до every - 1 лишних итераций.
+     */
+    void setCheckEvery(int every) {
+        check_every_ = std::max(1, every);
+    }
+
+    /**
+     * @brief Ёмкость кольцевого буфера телеметрии и файл (.csv или .json), в который он выгружается
+     *        после решения; пустой path - не выгружать.
+     */
+    void setTelemetry(const std::string &path, size_t capacity) {
+        telemetry_path_ = path;
+        telemetry_ = Telemetry(capacity);
+    }
+
     void solve() {
-        initMatrix();
+        if (operator_ == OperatorType::Dense) {
+            initMatrix();
+        }
         initB();
+        telemetry_.start();
 
-        double *Axmb = new double[size_];
         double norm_b = norm(b_);
-        double norm_Axmb;
+        double relative_residual = 0.0;
+        int iter;
+
+        if (method_ == SolverMethod::Multigrid) {
+            iter = solve_multigrid(norm_b, relative_residual);
+        } else if (method_ == SolverMethod::RedBlackSOR) {
+            iter = solve_sor(norm_b, relative_residual);
+        } else if (mixed_precision_) {
+            iter = solve_mixed(norm_b, relative_residual);
+        } else if (method_ == SolverMethod::Richardson) {
+            iter = solve_richardson(norm_b, relative_residual);
+        } else {
+            iter = cg(x_, b_, norm_b, epsilon_, max_iter_, relative_residual, 0);
+        }
+
+        telemetry_.print(method_ == SolverMethod::Multigrid ? "Cycle" : "Iteration", "Residual norm");
+        if (!telemetry_path_.empty()) {
+            telemetry_.write(telemetry_path_);
+        }
+
+        const char *unit = (method_ == SolverMethod::Multigrid) ? " cycles" : " iterations";
+        std::cout << "\nConverged after " << iter << unit << ". Final relative residual = "
+                << relative_residual << std::endl;
+        if (start_iter_ > 0) {
+            std::cout << "Resumed from iteration " << start_iter_ << ", total " << start_iter_ + iter << unit
+                    << std::endl;
+        }
+        if (checkpoint_) {
+            checkpoint_->write(x_, start_iter_ + iter);
+        }
+    }
+
+    const double *getSolution() const {
+        return x_;
+    }
+
+    int getSize() const {
+        return size_;
+    }
+};
+
+/**
+ * @brief Одновременное решение K задач с одним оператором и разными температурами углов.
+ *        Правые части и решения хранятся вперемежку: значение задачи k в узле i - x_[i * K + k].
+ *        Шаблон применяется один раз за итерацию сразу ко всем K задачам, а внутренний цикл
+ *        по задачам непрерывен в памяти и векторизуется. Поддерживаются Richardson и CG
+ *        (отдельные скаляры alpha/beta для каждой задачи).
+ */
+class BatchThermalSolver {
+private:
+    int Nx_, Ny_;
+    int size_;
+    int lanes_;
+    double tau_;
+    double epsilon_;
+    int max_iter_;
+    int num_threads_ = 1;
+    SolverMethod method_ = SolverMethod::Richardson;
+    int check_every_ = 1; // нормы невязок задач для проверки сходимости - раз в check_every_ итераций
+    Telemetry telemetry_{1 << 16};
+    std::string telemetry_path_;
+
+    std::vector<std::array<double, 4>> corners_;
+    std::vector<double> b_;        // size_ * lanes_
+    std::vector<double> x_;        // size_ * lanes_
+    std::vector<double> zero_row_; // Nx_ * lanes_ нулей - соседняя строка за границей сетки
+
+    /**
+     * @brief res = S(x) - y для всех задач; при y == nullptr res = S(x).
+     *        Строка сетки - Nx_ * lanes_ подряд идущих значений, соседи по столбцу отстоят на lanes_.
+     */
+    void stencil_sub(double *res, const double *x, const double *y) const {
+        const int K = lanes_;
+        const int n = Nx_ * K;
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+        for (int row = 0; row < Ny_; ++row) {
+            const size_t i = static_cast<size_t>(row) * n;
+            const double *c = x + i;
+            const double *up = (row > 0) ? c - n : zero_row_.data();
+            const double *down = (row < Ny_ - 1) ? c + n : zero_row_.data();
+            const double *rhs = y ? y + i : zero_row_.data();
+            double *out = res + i;
+            // Крайние столбцы: сосед слева или справа отсутствует.
+            auto edge = [&](int first) {
+                for (int k = first; k < first + K; ++k) {
+                    double sum = -4.0 * c[k] + up[k] + down[k] - rhs[k];
+                    if (k >= K) sum += c[k - K];
+                    if (k + K < n) sum += c[k + K];
+                    out[k] = sum;
+                }
+            };
+            edge(0);
+            if (n > K) edge(n - K);
+#pragma omp simd
+            for (int k = K; k < n - K; ++k) {
+                out[k] = -4.0 * c[k] + c[k - K] + c[k + K] + up[k] + down[k] - rhs[k];
+            }
+        }
+    }
+
+    /**
+     * @brief Шаг Ричардсона для всех задач за один проход по памяти: невязка r = S(x) - b,
+     *        её квадраты в squares[k] по задачам и x_new = x - tau_ * r (как richardson_sweep
+     *        у ThermalSolver). Внутренний цикл - по задачам одного узла, он непрерывен в памяти.
+     *        При Norm = false квадраты невязок не накапливаются - шаг между проверками сходимости.
+     */
+    template <bool Norm = true>
+    void richardson_sweep(double *x_new, const double *x, double *squares) const {
+        const int K = lanes_;
+        const int n = Nx_ * K;
+        const double tau = tau_;
+        std::fill(squares, squares + K, 0.0);
+#pragma omp parallel num_threads(num_threads_)
+        {
+            // Квадраты невязок по позициям строки; по задачам (k % K) сворачиваются в конце.
+            std::vector<double> row_squares(Norm ? n : 0, 0.0);
+            double *sq = row_squares.data();
+#pragma omp for schedule(static)
+            for (int row = 0; row < Ny_; ++row) {
+                const size_t i = static_cast<size_t>(row) * n;
+                const double *c = x + i;
+                const double *up = (row > 0) ? c - n : zero_row_.data();
+                const double *down = (row < Ny_ - 1) ? c + n : zero_row_.data();
+                const double *rhs = b_.data() + i;
+                double *out = x_new + i;
+                // Крайние столбцы: сосед слева или справа отсутствует.
+                auto edge = [&](int first) {
+                    for (int k = first; k < first + K; ++k) {
+                        double r = -4.0 * c[k] + up[k] + down[k] - rhs[k];
+                        if (k >= K) r += c[k - K];
+                        if (k + K < n) r += c[k + K];
+                        if constexpr (Norm) sq[k] += r * r;
+                        out[k] = c[k] - tau * r;
+                    }
+                };
+                edge(0);
+                if (n > K) edge(n - K);
+#pragma omp simd
+                for (int k = K; k < n - K; ++k) {
+                    double r = -4.0 * c[k] + c[k - K] + c[k + K] + up[k] + down[k] - rhs[k];
+                    if constexpr (Norm) sq[k] += r * r;
+                    out[k] = c[k] - tau * r;
+                }
+            }
+            if constexpr (Norm) {
+#pragma omp critical
+                for (int k = 0; k < n; ++k) {
+                    squares[k % K] += sq[k];
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Скалярные произведения по каждой задаче: out[k] = sum_i u[i*K + k] * v[i*K + k].
+     */
+    void lane_dots(const double *u, const double *v, double *out) const {
+        const int K = lanes_;
+        std::fill(out, out + K, 0.0);
+#pragma omp parallel for num_threads(num_threads_) schedule(static) reduction(+:out[:K])
+        for (int i = 0; i < size_; ++i) {
+            for (int k = 0; k < K; ++k) {
+                out[k] += u[static_cast<size_t>(i) * K + k] * v[static_cast<size_t>(i) * K + k];
+            }
+        }
+    }
+
+    /**
+     * @brief Максимальная по задачам относительная невязка.
+     */
+    double worst(const std::vector<double> &squares, const std::vector<double> &norm_b,
+                 std::vector<double> &relative) const {
+        double w = 0.0;
+        for (int k = 0; k < lanes_; ++k) {
+            relative[k] = std::sqrt(squares[k]) / norm_b[k];
+            w = std::max(w, relative[k]);
+        }
+        return w;
+    }
+
+    /**
+     * @brief Итерация с проверкой сходимости: каждая check_every_-я и последняя допустимая.
+     */
+    bool is_check_iteration(int iter) const {
+        return iter % check_every_ == 0 || iter >= max_iter_;
+    }
+
+    /**
+     * @brief Заносит худшую по задачам невязку в кольцевой буфер телеметрии.
+     */
+    void report_progress(int iter, double relative_residual) {
+        telemetry_.record(iter, relative_residual);
+    }
+
+    /**
+     * @brief Ричардсон с общим tau_: все задачи продолжают итерации, пока не сойдётся худшая.
+     */
+    int solve_richardson(const std::vector<double> &norm_b, std::vector<double> &relative) {
+        std::vector<double> x_next(x_.size()), squares(lanes_);
         int iter = 0;
+        double w = 0.0;
+        bool check;
 
         do {
-            mul_mv_sub(Axmb, A_, x_, b_);
-            norm_Axmb = norm(Axmb);
-            next(x_, Axmb);
+            check = is_check_iteration(iter + 1);
+            if (check) {
+                richardson_sweep(x_next.data(), x_.data(), squares.data());
+            } else {
+                richardson_sweep<false>(x_next.data(), x_.data(), squares.data());
+            }
+            x_.swap(x_next);
             iter++;
-
-            if (iter % 1000 == 0 || iter == 1) {
-                std::cout << "Iteration " << iter << ": Residual norm = " << norm_Axmb / norm_b << std::endl;
+            if (check) {
+                w = worst(squares, norm_b, relative);
+                report_progress(iter, w);
             }
 
             if (iter >= max_iter_) break;
-        } while (norm_Axmb / norm_b >= epsilon_);
+        } while (!check || w >= epsilon_);
+
+        return iter;
+    }
+
+    /**
+     * @brief CG для -A с отдельными alpha/beta для каждой задачи; сошедшиеся задачи замораживаются.
+     */
+    int solve_cg(const std::vector<double> &norm_b, std::vector<double> &relative) {
+        const int K = lanes_;
+        const size_t total = static_cast<size_t>(size_) * K;
+        std::vector<double> r(total), p(total), q(total);
+        std::vector<double> rr(K), pq(K), alpha(K), beta(K);
+
+        stencil_sub(r.data(), x_.data(), b_.data());
+        p = r;
+        lane_dots(r.data(), r.data(), rr.data());
+        double w = worst(rr, norm_b, relative);
+        int iter = 0;
+
+        while (w >= epsilon_ && iter < max_iter_) {
+            stencil_sub(q.data(), p.data(), nullptr);
+            lane_dots(p.data(), q.data(), pq.data());
+            for (int k = 0; k < K; ++k) {
+                alpha[k] = (relative[k] < epsilon_) ? 0.0 : -rr[k] / pq[k];
+            }
 
-        std::cout << "\nConverged after " << iter << " iterations. Final relative residual = "
-                << norm_Axmb / norm_b << std::endl;
+            const double *a = alpha.data();
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+            for (int i = 0; i < size_; ++i) {
+#pragma omp simd
+                for (int k = 0; k < K; ++k) {
+                    size_t j = static_cast<size_t>(i) * K + k;
+                    x_[j] += a[k] * p[j];
+                    r[j] += a[k] * q[j];
+                }
+            }
+
+            std::vector<double> rr_next(K);
+            lane_dots(r.data(), r.data(), rr_next.data());
+            for (int k = 0; k < K; ++k) {
+                beta[k] = (rr[k] > 0.0) ? rr_next[k] / rr[k] : 0.0;
+            }
+            rr = rr_next;
+            w = worst(rr, norm_b, relative);
+            iter++;
+            if (is_check_iteration(iter)) report_progress(iter, w);
+
+            const double *bt = beta.data();
+#pragma omp parallel for num_threads(num_threads_) schedule(static)
+            for (int i = 0; i < size_; ++i) {
+#pragma omp simd
+                for (int k = 0; k < K; ++k) {
+                    size_t j = static_cast<size_t>(i) * K + k;
+                    p[j] = r[j] + bt[k] * p[j];
+                }
+            }
+        }
 
-        delete[] Axmb;
+        return iter;
     }
 
-    const double *getSolution() const {
-        return x_;
+public:
+    BatchThermalSolver(int Nx, int Ny, double epsilon, int max_iter, double tau,
+                       std::vector<std::array<double, 4>> corners)
+        : Nx_(Nx), Ny_(Ny), size_(Nx * Ny), lanes_(static_cast<int>(corners.size())), tau_(tau),
+          epsilon_(epsilon), max_iter_(max_iter), corners_(std::move(corners)),
+          b_(static_cast<size_t>(size_) * lanes_), x_(static_cast<size_t>(size_) * lanes_),
+          zero_row_(static_cast<size_t>(Nx) * lanes_) {
+    }
+
+    /**
+     * @brief Число потоков OpenMP; 0 - все доступные ядра.
+     */
+    void setThreads(int num_threads) {
+        num_threads_ = (num_threads > 0) ? num_threads : omp_get_max_threads();
+    }
+
+    /**
+     * @brief Richardson или CG; предобусловленные варианты CG сводятся к CG (диагональ шаблона постоянна).
+     * @return false, если метод не поддерживается пакетным решателем.
+     */
+    bool setMethod(SolverMethod method) {
+        if (method == SolverMethod::Richardson || method == SolverMethod::CG || method == SolverMethod::PCGJacobi) {
+            method_ = method;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Отчёт о ходе решения раз в every итераций (см. ThermalSolver::setCheckEvery).
+     *        CG всё равно считает нормы невязок на каждой итерации, для Ричардсона
+     *        они считаются и проверяются только раз в every итераций.
+     */
+    void setCheckEvery(int every) {
+        check_every_ = std::max(1, every);
+    }
+
+    /**
+     * @brief Ёмкость кольцевого буфера телеметрии и файл, в который он выгружается; пустой path - не выгружать.
+     */
+    void setTelemetry(const std::string &path, size_t capacity) {
+        telemetry_path_ = path;
+        telemetry_ = Telemetry(capacity);
+    }
+
+    void solve() {
+        std::fill(b_.begin(), b_.end(), 0.0);
+        for (int k = 0; k < lanes_; ++k) {
+            fill_boundary(b_.data(), Nx_, Ny_, corners_[k].data(), lanes_, k);
+        }
+
+        std::vector<double> norm_b(lanes_), relative(lanes_);
+        lane_dots(b_.data(), b_.data(), norm_b.data());
+        for (double &nb : norm_b) nb = std::sqrt(nb);
+
+        telemetry_.start();
+        int iter = (method_ == SolverMethod::Richardson) ? solve_richardson(norm_b, relative)
+                                                          : solve_cg(norm_b, relative);
+
+        telemetry_.print("Iteration", "Max residual norm");
+        if (!telemetry_path_.empty()) {
+            telemetry_.write(telemetry_path_);
+        }
+
+        std::cout << "\nConverged after " << iter << " iterations." << std::endl;
+        for (int k = 0; k < lanes_; ++k) {
+            std::cout << "  set " << k << " {" << corners_[k][0] << ", " << corners_[k][1] << ", "
+                    << corners_[k][2] << ", " << corners_[k][3] << "}: relative residual = " << relative[k]
+                    << std::endl;
+        }
+    }
+
+    /**
+     * @brief Решение задачи lane в обычном (не чередующемся) порядке узлов.
+     */
+    std::vector<double> getSolution(int lane) const {
+        std::vector<double> x(size_);
+        for (int i = 0; i < size_; ++i) {
+            x[i] = x_[static_cast<size_t>(i) * lanes_ + lane];
+        }
+        return x;
     }
 
     int getSize() const {
         return size_;
     }
+
+    int getBatchSize() const {
+        return lanes_;
+    }
 };
 
 #endif
\ No newline at end of file
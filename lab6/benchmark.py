@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""
+benchmark.py
+
+This script runs the lab6 heat solver (Richardson method, stencil operator)
+for a fixed number of iterations with the naive sweep and with several
+temporal blocking configurations, and reports iterations per second and
+effective memory bandwidth for each of them.
+"""
+
+import argparse
+import csv
+import subprocess
+from typing import List, Optional, Tuple
+
+# One naive Richardson step reads x and b and writes x_next: 3 doubles per grid point.
+BYTES_PER_POINT = 3 * 8
+
+
+def run_solver(executable: str, grid_size: int, iterations: int, threads: int,
+               tile_rows: int, tile_depth: int) -> Optional[float]:
+    """
+    Run the solver with epsilon = 0, so that exactly `iterations` steps are made.
+
+    Args:
+        executable: Path to the lab6_cpp executable.
+        grid_size: Grid side.
+        iterations: Number of Richardson steps.
+        threads: Number of OpenMP threads (0 - all cores).
+        tile_rows: Band height for temporal blocking (0 - naive sweep).
+        tile_depth: Richardson steps per band load.
+
+    Returns:
+        Solve time in seconds, or None if the run failed.
+    """
+    cmd = [executable, "-g", str(grid_size), "-e", "0", "-i", str(iterations),
+           "-t", str(threads), "--tile-rows", str(tile_rows), "--tile-depth", str(tile_depth)]
+    try:
+        result = subprocess.run(cmd, capture_output=True, text=True, timeout=3600)
+    except subprocess.TimeoutExpired:
+        print("Timeout.")
+        return None
+
+    if result.returncode != 0:
+        print("Execution failed:")
+        print(result.stderr)
+        return None
+
+    for line in result.stdout.splitlines():
+        if "Время работы алгоритма" in line:
+            return float(line.split()[-2])
+    return None
+
+
+def parse_tiles(values: List[str]) -> List[Tuple[int, int]]:
+    """
+    Parse blocking configurations given as ROWSxDEPTH, e.g. 32x4.
+    """
+    tiles = []
+    for value in values:
+        rows, depth = value.lower().split("x")
+        tiles.append((int(rows), int(depth)))
+    return tiles
+
+
+def main() -> None:
+    """
+    Entry point of the script. Parses arguments, runs the naive and blocked
+    sweeps and writes results to a CSV file.
+    """
+    parser = argparse.ArgumentParser(description="Benchmark temporal blocking of the lab6 heat solver.")
+    parser.add_argument("--executable", type=str, default="build/lab6_cpp", help="Path to lab6_cpp.")
+    parser.add_argument("--grid-sizes", type=int, nargs="+", default=[1024, 2048, 4096], help="Grid sides.")
+    parser.add_argument("--iterations", type=int, default=200, help="Richardson steps per run.")
+    parser.add_argument("--threads", type=int, default=0, help="OpenMP threads (0 - all cores).")
+    parser.add_argument("--tiles", type=str, nargs="+", default=["32x4", "64x8", "128x16"],
+                        help="Blocking configurations ROWSxDEPTH.")
+    parser.add_argument("--csv", type=str, default="blocking_results.csv", help="Path to the output CSV file.")
+
+    args = parser.parse_args()
+    configs = [(0, 1)] + parse_tiles(args.tiles)
+
+    with open(args.csv, mode="w", newline="") as file:
+        writer = csv.writer(file)
+        writer.writerow(["GridSize", "TileRows", "TileDepth", "Time_s", "Iterations_per_s", "Effective_GBps"])
+
+        for grid_size in args.grid_sizes:
+            for tile_rows, tile_depth in configs:
+                name = "naive" if tile_rows == 0 else f"{tile_rows}x{tile_depth}"
+                print(f"grid {grid_size}, {name}...", end=" ", flush=True)
+
+                elapsed = run_solver(args.executable, grid_size, args.iterations, args.threads,
+                                     tile_rows, tile_depth)
+                if elapsed is None:
+                    print("Failed.")
+                    continue
+
+                # Bandwidth is counted as the naive sweep's traffic, so blocked runs show
+                # how much faster than the DRAM-bound sweep they are.
+                iterations_per_s = args.iterations / elapsed
+                gbps = iterations_per_s * grid_size * grid_size * BYTES_PER_POINT / 1e9
+                print(f"{elapsed:.4f} s, {iterations_per_s:.1f} it/s, {gbps:.2f} GB/s")
+                writer.writerow([grid_size, tile_rows, tile_depth, round(elapsed, 4),
+                                 round(iterations_per_s, 2), round(gbps, 3)])
+
+
+if __name__ == "__main__":
+    main()
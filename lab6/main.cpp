@@ -2,6 +2,9 @@
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <cmath>
+#include <sstream>
+#include <vector>
 #include "all_classes.h"
 
 #define YELLOW "\033[33m"
@@ -14,6 +17,44 @@ namespace po = boost::program_options;
 
 void report_option_defaults(po::variables_map &vm);
 
+/**
+ * @brief Переводит значение параметра --operator в OperatorType.
+ * @return false, если значение не распознано.
+ */
+bool parse_operator(const std::string &name, OperatorType &op) {
+    if (name == "dense") {
+        op = OperatorType::Dense;
+    } else if (name == "stencil") {
+        op = OperatorType::Stencil;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Переводит значение параметра --method в SolverMethod.
+ * @return false, если значение не распознано.
+ */
+bool parse_method(const std::string &name, SolverMethod &method) {
+    if (name == "richardson") {
+        method = SolverMethod::Richardson;
+    } else if (name == "cg") {
+        method = SolverMethod::CG;
+    } else if (name == "pcg-jacobi") {
+        method = SolverMethod::PCGJacobi;
+    } else if (name == "pcg-ic0") {
+        method = SolverMethod::PCGIC0;
+    } else if (name == "multigrid") {
+        method = SolverMethod::Multigrid;
+    } else if (name == "sor") {
+        method = SolverMethod::RedBlackSOR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
 void record_results(int grid_size, long double *x) {
     FILE *f = fopen(OUT_FILE, "w");
     fwrite(x, sizeof(double), grid_size * grid_size, f);
@@ -30,6 +71,74 @@ void saveSolution(const char* filename, const double* x, int size) {
     }
 }
 
+/**
+ * @brief Разбирает наборы температур углов вида "10,20,30,20".
+ * @return false, если хотя бы один набор не состоит из четырёх чисел.
+ */
+bool parse_corners(const std::vector<std::string> &values, std::vector<std::array<double, 4>> &sets) {
+    for (const std::string &value: values) {
+        std::array<double, 4> corners{};
+        std::stringstream ss(value);
+        std::string item;
+        int count = 0;
+        while (std::getline(ss, item, ',')) {
+            if (count == 4) return false;
+            try {
+                corners[count++] = std::stod(item);
+            } catch (const std::exception &) {
+                return false;
+            }
+        }
+        if (count != 4) return false;
+        sets.push_back(corners);
+    }
+    return true;
+}
+
+/**
+ * @brief Читает решение из result.dat (nx * nx значений double без заголовка) или из файла
+ *        контрольной точки (CheckpointHeader + nx * ny значений).
+ * @return false, если файл не читается или его размер не соответствует ни одному формату.
+ */
+bool loadSolution(const char *filename, std::vector<double> &x, int &nx, int &ny, int &iteration) {
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        std::cerr << "Error opening file " << filename << " for reading.\n";
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long bytes = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    CheckpointHeader header{};
+    bool ok = false;
+    if (bytes >= static_cast<long>(sizeof(header)) && fread(&header, sizeof(header), 1, f) == 1 &&
+        std::memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) == 0) {
+        nx = header.nx;
+        ny = header.ny;
+        iteration = static_cast<int>(header.iteration);
+        ok = header.iteration >= 0 &&
+             bytes == static_cast<long>(sizeof(header) + static_cast<size_t>(nx) * ny * sizeof(double));
+    } else {
+        fseek(f, 0, SEEK_SET);
+        long count = bytes / static_cast<long>(sizeof(double));
+        nx = ny = static_cast<int>(std::lround(std::sqrt(static_cast<double>(count))));
+        iteration = 0;
+        ok = count > 0 && static_cast<long>(nx) * ny == count && count * static_cast<long>(sizeof(double)) == bytes;
+    }
+
+    if (ok) {
+        x.resize(static_cast<size_t>(nx) * ny);
+        ok = fread(x.data(), sizeof(double), x.size(), f) == x.size();
+    }
+    fclose(f);
+
+    if (!ok) {
+        std::cerr << "File " << filename << " is neither a result.dat nor a complete checkpoint.\n";
+    }
+    return ok;
+}
+
 int main(int argc, char *argv[]) {
     double epsilon;
     int grid_size, itterations;
@@ -39,7 +148,39 @@ int main(int argc, char *argv[]) {
             ("help,h", "Показать справку")
             ("epsilon,e", po::value<double>()->default_value(0.01), "Точность вычислений")
             ("grid-size,g", po::value<int>()->default_value(30), "Размер сетки")
-            ("itterations,i", po::value<int>()->default_value(1e6), "Количество иттераций");
+            ("itterations,i", po::value<int>()->default_value(1e6), "Количество иттераций")
+            ("operator,o", po::value<std::string>()->default_value("stencil"),
+             "Оператор Лапласа: dense (плотная матрица) | stencil (пятиточечный шаблон)")
+            ("threads,t", po::value<int>()->default_value(0), "Количество потоков (0 - все доступные ядра)")
+            ("method,m", po::value<std::string>()->default_value("richardson"),
+             "Метод: richardson | cg | pcg-jacobi | pcg-ic0 | multigrid | sor")
+            ("mg-cycle", po::value<std::string>()->default_value("V"), "Тип многосеточного цикла: V | W")
+            ("mg-pre", po::value<int>()->default_value(2), "Число сглаживаний перед грубой поправкой")
+            ("mg-post", po::value<int>()->default_value(2), "Число сглаживаний после грубой поправки")
+            ("omega", po::value<double>()->default_value(0.0),
+             "Параметр релаксации SOR (0 - оптимальный для сетки, 1 - Гаусс-Зейдель)")
+            ("tile-rows", po::value<int>()->default_value(0),
+             "Высота полосы временной блокировки для richardson (0 - без блокировки)")
+            ("tile-depth", po::value<int>()->default_value(4), "Число шагов richardson на одну загрузку полосы")
+            ("precision", po::value<std::string>()->default_value("double"),
+             "Точность итераций: double | mixed (float с уточнением в double; richardson и cg-методы)")
+            ("corners", po::value<std::vector<std::string>>()->multitoken(),
+             "Наборы температур углов \"t0,t1,t2,t3\" для пакетного решения (richardson | cg | pcg-jacobi); "
+             "решения пишутся в result_<k>.dat")
+            ("initial", po::value<std::string>(),
+             "Начальное приближение: result.dat или контрольная точка (другая сетка интерполируется)")
+            ("checkpoint-every", po::value<int>()->default_value(0),
+             "Писать контрольную точку каждые N итераций (0 - не писать)")
+            ("checkpoint-file", po::value<std::string>()->default_value("checkpoint.dat"),
+             "Файл контрольной точки")
+            ("domains", po::value<int>()->default_value(0),
+             "Разбиение сетки на полосы с обменом ореолами для richardson, по потоку на полосу (0 - без разбиения)")
+            ("check-every", po::value<int>()->default_value(1),
+             "Проверять сходимость (считать норму невязки) раз в N итераций")
+            ("telemetry", po::value<std::string>()->default_value(""),
+             "Файл для истории невязок: *.json - JSON, иначе CSV (пусто - не писать)")
+            ("telemetry-size", po::value<int>()->default_value(1 << 16),
+             "Ёмкость кольцевого буфера телеметрии (записей; при переполнении ранние затираются)");
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
     po::notify(vm);
@@ -54,9 +195,119 @@ int main(int argc, char *argv[]) {
     grid_size = vm["grid-size"].as<int>();
     itterations = vm["itterations"].as<int>();
 
+    OperatorType op;
+    if (!parse_operator(vm["operator"].as<std::string>(), op)) {
+        std::cerr << "Неизвестный оператор: " << vm["operator"].as<std::string>() << std::endl;
+        return 1;
+    }
+
+    SolverMethod method;
+    if (!parse_method(vm["method"].as<std::string>(), method)) {
+        std::cerr << "Неизвестный метод: " << vm["method"].as<std::string>() << std::endl;
+        return 1;
+    }
+
+    const std::string &cycle = vm["mg-cycle"].as<std::string>();
+    if (cycle != "V" && cycle != "W") {
+        std::cerr << "Неизвестный тип цикла: " << cycle << std::endl;
+        return 1;
+    }
+
+    const std::string &precision = vm["precision"].as<std::string>();
+    if (precision != "double" && precision != "mixed") {
+        std::cerr << "Неизвестная точность: " << precision << std::endl;
+        return 1;
+    }
+    if (precision == "mixed" && (method == SolverMethod::Multigrid || method == SolverMethod::RedBlackSOR)) {
+        std::cerr << "Смешанная точность поддерживается только для richardson и cg-методов" << std::endl;
+        return 1;
+    }
+
+    // Временная блокировка и разбиение на полосы есть только у Ричардсона в double с шаблонным оператором.
+    const bool plain_richardson =
+            method == SolverMethod::Richardson && precision == "double" && op == OperatorType::Stencil;
+    if (vm["tile-rows"].as<int>() > 0 && !plain_richardson) {
+        std::cerr << "--tile-rows поддерживается только для richardson с оператором stencil и точностью double"
+                << std::endl;
+        return 1;
+    }
+    if (vm["domains"].as<int>() > 1 && !plain_richardson) {
+        std::cerr << "--domains поддерживается только для richardson с оператором stencil и точностью double"
+                << std::endl;
+        return 1;
+    }
+    if (vm["tile-rows"].as<int>() > 0 && vm["domains"].as<int>() > 1) {
+        std::cerr << "--tile-rows и --domains нельзя задавать вместе" << std::endl;
+        return 1;
+    }
+
+    if (vm.count("corners")) {
+        std::vector<std::array<double, 4>> sets;
+        if (!parse_corners(vm["corners"].as<std::vector<std::string>>(), sets)) {
+            std::cerr << "Набор температур углов должен состоять из четырёх чисел через запятую" << std::endl;
+            return 1;
+        }
+
+        // Параметры, которые использует пакетный решатель; любой другой, заданный явно, - ошибка.
+        const std::vector<std::string> batch_options = {"epsilon", "grid-size", "itterations", "threads",
+                                                        "method", "corners", "check-every", "telemetry",
+                                                        "telemetry-size"};
+        for (const auto &option: vm) {
+            if (!option.second.defaulted() &&
+                std::find(batch_options.begin(), batch_options.end(), option.first) == batch_options.end()) {
+                std::cerr << "Параметр --" << option.first << " не поддерживается пакетным решением (--corners)"
+                        << std::endl;
+                return 1;
+            }
+        }
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        BatchThermalSolver batch(grid_size, grid_size, epsilon, itterations, -0.01, sets);
+        batch.setThreads(vm["threads"].as<int>());
+        batch.setCheckEvery(vm["check-every"].as<int>());
+        batch.setTelemetry(vm["telemetry"].as<std::string>(), std::max(1, vm["telemetry-size"].as<int>()));
+        if (!batch.setMethod(method)) {
+            std::cerr << "Пакетное решение поддерживает только richardson, cg и pcg-jacobi" << std::endl;
+            return 1;
+        }
+        batch.solve();
+
+        auto end_time = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed_seconds = end_time - start_time;
+        std::cout << "Время работы алгоритма: " << elapsed_seconds.count() << " секунд" << std::endl;
+
+        for (int k = 0; k < batch.getBatchSize(); ++k) {
+            std::string filename = "result_" + std::to_string(k) + ".dat";
+            saveSolution(filename.c_str(), batch.getSolution(k).data(), batch.getSize());
+        }
+        return 0;
+    }
+
     auto start_time = std::chrono::high_resolution_clock::now();
 
     ThermalSolver solver(grid_size, grid_size, epsilon, itterations, -0.01);
+    solver.setOperator(op);
+    solver.setThreads(vm["threads"].as<int>());
+    solver.setMethod(method);
+    solver.setMultigrid(cycle == "W" ? MultigridCycle::W : MultigridCycle::V,
+                        vm["mg-pre"].as<int>(), vm["mg-post"].as<int>());
+    solver.setOmega(vm["omega"].as<double>());
+    solver.setTemporalBlocking(vm["tile-rows"].as<int>(), vm["tile-depth"].as<int>());
+    solver.setMixedPrecision(precision == "mixed");
+    solver.setDomains(vm["domains"].as<int>());
+    solver.setCheckEvery(vm["check-every"].as<int>());
+    solver.setTelemetry(vm["telemetry"].as<std::string>(), std::max(1, vm["telemetry-size"].as<int>()));
+    if (vm.count("initial")) {
+        std::vector<double> initial;
+        int nx, ny, iteration;
+        if (!loadSolution(vm["initial"].as<std::string>().c_str(), initial, nx, ny, iteration)) {
+            return 1;
+        }
+        solver.setInitialGuess(initial, nx, ny, iteration);
+    }
+    // После чтения начального приближения: файл контрольной точки может быть тем же самым.
+    solver.setCheckpoint(vm["checkpoint-file"].as<std::string>(), vm["checkpoint-every"].as<int>());
     solver.solve();
 
     auto end_time = std::chrono::high_resolution_clock::now();
@@ -91,4 +342,28 @@ void report_option_defaults(po::variables_map &vm) {
         std::cout << GREEN << "Параметр 'itterations' задан явно: "
                 << vm["itterations"].as<int>() << RESET << std::endl;
     }
+
+    if (vm["operator"].defaulted()) {
+        std::cout << YELLOW << "[Warning] Параметр 'operator' не задан. Используется значение по умолчанию: "
+                << vm["operator"].as<std::string>() << RESET << std::endl;
+    } else {
+        std::cout << GREEN << "Параметр 'operator' задан явно: "
+                << vm["operator"].as<std::string>() << RESET << std::endl;
+    }
+
+    if (vm["threads"].defaulted()) {
+        std::cout << YELLOW << "[Warning] Параметр 'threads' не задан. Используется значение по умолчанию: "
+                << vm["threads"].as<int>() << RESET << std::endl;
+    } else {
+        std::cout << GREEN << "Параметр 'threads' задан явно: "
+                << vm["threads"].as<int>() << RESET << std::endl;
+    }
+
+    if (vm["method"].defaulted()) {
+        std::cout << YELLOW << "[Warning] Параметр 'method' не задан. Используется значение по умолчанию: "
+                << vm["method"].as<std::string>() << RESET << std::endl;
+    } else {
+        std::cout << GREEN << "Параметр 'method' задан явно: "
+                << vm["method"].as<std::string>() << RESET << std::endl;
+    }
 }